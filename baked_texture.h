@@ -0,0 +1,362 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+// On-disk cache of ready-to-upload stereo textures. A baked file holds every mip level of
+// one or two textures (whole stereo pair, or one per eye) exactly as glTexImage2D wants them,
+// so loading one is an mmap plus the GL uploads, with no decode, split or mip generation.
+//
+// Layout: BakedHeader, then textureCount * levelCount BakedLevel entries, then the level
+// data, each level starting on a BAKED_DATA_ALIGNMENT boundary with rows padded to 4 bytes.
+
+#include "opencv2/opencv.hpp"
+#include "decoded_image.h"
+#include "fnv1a.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char BAKED_MAGIC[8] = {'G', 'L', 'V', 'R', 'T', 'E', 'X', '\0'};
+// 2: mips of a whole stereo pair are built per eye half
+const uint32_t BAKED_VERSION = 2;
+const uint32_t BAKED_DATA_ALIGNMENT = 4096;
+const uint32_t BAKED_MAX_LEVELS = 32;
+
+// pixel formats of the level data; room is left for block compressed formats
+enum BakedPixelFormat {
+    BAKED_BGR8,
+    BAKED_BGRA8,
+    BAKED_RGB8,
+    BAKED_RGBA8
+};
+
+struct BakedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t pixelFormat;
+    uint32_t textureCount;
+    uint32_t levelCount;
+    uint32_t reserved;
+};
+
+struct BakedLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowBytes;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+// Read-only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            close();
+            return false;
+        }
+        bytes = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t) fileSize.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        void *address = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        bytes = (const uint8_t*) address;
+        length = (size_t) info.st_size;
+#endif
+        if (!bytes)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes)
+            UnmapViewOfFile(bytes);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes)
+            munmap((void*) bytes, length);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    // Reads bytes [begin, end) of the file in now, on the calling thread, so whoever reads the
+    // mapping next (the GL upload on the render thread) finds those pages resident instead of
+    // waiting on disk
+    void prefault(size_t begin = 0, size_t end = SIZE_MAX) const
+    {
+        // 4 KB pages, the smallest page size of any platform we run on
+        begin &= ~(size_t) 4095;
+        end = std::min(end, length);
+        if (begin >= end)
+            return;
+#ifndef _WIN32
+        madvise((void*) (bytes + begin), end - begin, MADV_WILLNEED);
+#endif
+        uint8_t sum = 0;
+        for (size_t offset = begin; offset < end; offset += 4096)
+            sum ^= ((const volatile uint8_t*) bytes)[offset];
+        (void) sum;
+    }
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// file a cache key is baked to inside directory
+inline std::string bakedTexturePath(const std::string &directory, const std::string &cacheKey)
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fnv1a64(cacheKey) << ".glvrtex";
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+inline uint32_t bakedPadding(uint64_t offset, uint32_t alignment)
+{
+    return (uint32_t) ((alignment - offset % alignment) % alignment);
+}
+
+// Writes every level of a decoded image. Goes through a temporary file so a reader never
+// maps a half written one.
+inline bool writeBakedTexture(const std::string &path, const DecodedImage &decoded)
+{
+    std::vector<std::vector<const cv::Mat*>> textures;
+    if (decoded.isSplit())
+    {
+        textures.resize(2);
+        textures[0].push_back(&decoded.left);
+        textures[1].push_back(&decoded.right);
+        for (const cv::Mat &mip : decoded.leftMips) textures[0].push_back(&mip);
+        for (const cv::Mat &mip : decoded.rightMips) textures[1].push_back(&mip);
+    }
+    else
+    {
+        textures.resize(1);
+        textures[0].push_back(&decoded.image);
+        for (const cv::Mat &mip : decoded.imageMips) textures[0].push_back(&mip);
+    }
+
+    const cv::Mat &base = *textures[0][0];
+    int channels = base.channels();
+    if (base.depth() != CV_8U || (channels != 3 && channels != 4))
+        return false;
+    if (textures.size() == 2 && textures[0].size() != textures[1].size())
+        return false;
+    if (textures[0].size() > BAKED_MAX_LEVELS)
+        return false;
+
+    BakedHeader header = {};
+    memcpy(header.magic, BAKED_MAGIC, sizeof(header.magic));
+    header.version = BAKED_VERSION;
+    header.layout = decoded.layout;
+    header.pixelFormat = decoded.rgbOrder ? (channels == 4 ? BAKED_RGBA8 : BAKED_RGB8)
+                                          : (channels == 4 ? BAKED_BGRA8 : BAKED_BGR8);
+    header.textureCount = (uint32_t) textures.size();
+    header.levelCount = (uint32_t) textures[0].size();
+
+    std::vector<BakedLevel> levels;
+    uint64_t offset = sizeof(BakedHeader) + sizeof(BakedLevel) * header.textureCount * header.levelCount;
+    for (const std::vector<const cv::Mat*> &texture : textures)
+    {
+        for (const cv::Mat *mat : texture)
+        {
+            BakedLevel level = {};
+            level.width = (uint32_t) mat->cols;
+            level.height = (uint32_t) mat->rows;
+            level.rowBytes = (uint32_t) ((mat->cols * channels + 3) & ~3);
+            offset += bakedPadding(offset, BAKED_DATA_ALIGNMENT);
+            level.offset = offset;
+            offset += (uint64_t) level.rowBytes * level.height;
+            levels.push_back(level);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write((const char*) &header, sizeof(header));
+        out.write((const char*) levels.data(), sizeof(BakedLevel) * levels.size());
+
+        std::vector<char> zeros(BAKED_DATA_ALIGNMENT, 0);
+        size_t index = 0;
+        for (const std::vector<const cv::Mat*> &texture : textures)
+        {
+            for (const cv::Mat *mat : texture)
+            {
+                const BakedLevel &level = levels[index++];
+                out.write(zeros.data(), level.offset - (uint64_t) out.tellp());
+                size_t rowBytes = mat->cols * channels;
+                for (int y = 0; y < mat->rows; y++)
+                {
+                    out.write((const char*) mat->ptr(y), rowBytes);
+                    out.write(zeros.data(), level.rowBytes - rowBytes);
+                }
+            }
+        }
+        if (!out)
+        {
+            out.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+// Maps a baked file and wraps its levels in Mats pointing straight into the mapping, the
+// mapping stays alive through decoded.storage. The pages are faulted in before returning, so
+// call it off the render thread. Fails on anything malformed or on textures larger than
+// maxTextureSize (when it is set).
+// firstLevel > 0 serves a reduced decode: that level becomes the base and the levels above it
+// are neither checked nor read.
+inline bool mapBakedTexture(const std::string &path, int maxTextureSize, DecodedImage &decoded, uint32_t firstLevel = 0)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path) || file->size() < sizeof(BakedHeader))
+        return false;
+
+    BakedHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, BAKED_MAGIC, sizeof(header.magic)) != 0 || header.version != BAKED_VERSION)
+        return false;
+    if (header.textureCount < 1 || header.textureCount > 2 || header.levelCount < 1 || header.levelCount > BAKED_MAX_LEVELS)
+        return false;
+    if (header.pixelFormat > BAKED_RGBA8 || firstLevel >= header.levelCount)
+        return false;
+
+    size_t tableEnd = sizeof(BakedHeader) + sizeof(BakedLevel) * header.textureCount * header.levelCount;
+    if (file->size() < tableEnd)
+        return false;
+    const BakedLevel *levels = (const BakedLevel*) (file->data() + sizeof(BakedHeader));
+
+    int channels = (header.pixelFormat == BAKED_BGRA8 || header.pixelFormat == BAKED_RGBA8) ? 4 : 3;
+    std::vector<cv::Mat> mats;
+    std::vector<const BakedLevel*> used;
+    for (uint32_t texture = 0; texture < header.textureCount; texture++)
+    {
+        for (uint32_t i = firstLevel; i < header.levelCount; i++)
+        {
+            const BakedLevel &level = levels[texture * header.levelCount + i];
+            if (level.rowBytes < level.width * channels || level.offset + (uint64_t) level.rowBytes * level.height > file->size())
+                return false;
+            if (maxTextureSize > 0 && (level.width > (uint32_t) maxTextureSize || level.height > (uint32_t) maxTextureSize))
+                return false;
+            void *pixels = (void*) (file->data() + level.offset);
+            mats.push_back(cv::Mat((int) level.height, (int) level.width, CV_8UC(channels), pixels, level.rowBytes));
+            used.push_back(&level);
+        }
+    }
+    uint32_t levelCount = header.levelCount - firstLevel;
+
+    decoded.layout = header.layout == TOP_BOTTOM ? TOP_BOTTOM : SIDE_BY_SIDE;
+    decoded.rgbOrder = header.pixelFormat == BAKED_RGB8 || header.pixelFormat == BAKED_RGBA8;
+    if (header.textureCount == 1)
+    {
+        decoded.image = mats[0];
+        decoded.imageMips.assign(mats.begin() + 1, mats.end());
+    }
+    else
+    {
+        decoded.left = mats[0];
+        decoded.leftMips.assign(mats.begin() + 1, mats.begin() + levelCount);
+        decoded.right = mats[levelCount];
+        decoded.rightMips.assign(mats.begin() + levelCount + 1, mats.end());
+    }
+    for (const BakedLevel *level : used)
+        file->prefault((size_t) level->offset, (size_t) (level->offset + (uint64_t) level->rowBytes * level->height));
+    decoded.storage = file;
+    return true;
+}
+#endif
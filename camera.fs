@@ -2,12 +2,23 @@
 out vec4 FragColor;
 
 in vec2 TexCoord;
+flat in vec4 EyeRect;
 
 // texture samplers
 uniform sampler2D texture1;
 uniform sampler2D texture2;
 
+// Keeps the filter footprint inside this eye's part of a shared texture: the sample point stays
+// half a texel of the sampled mip level off the rect's edges. A screen pixel's footprint is one
+// texel of the finer level trilinear filtering reads, half a texel of the coarser one.
+vec2 clampToEye(sampler2D tex, vec2 uv, vec4 rect)
+{
+	vec2 inset = max(0.5 / vec2(textureSize(tex, 0)), fwidth(uv));
+	return clamp(uv, rect.xy + inset, rect.zw - inset);
+}
+
 void main()
 {
-	FragColor = texture(texture1, TexCoord);
+	// gradients of the unclamped coordinates, so clamping never changes the mip level
+	FragColor = textureGrad(texture1, clampToEye(texture1, TexCoord, EyeRect), dFdx(TexCoord), dFdy(TexCoord));
 }
\ No newline at end of file
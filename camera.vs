@@ -3,12 +3,23 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
+// this eye's part of the texture, xy = min, zw = max
+flat out vec4 EyeRect;
 
-uniform mat4 mvp;
+// both eyes of the frame: 0 = left, 1 = right
+layout (std140) uniform StereoFrame
+{
+	mat4 mvp[2];
+	// xy = scale, zw = bias, selects each eye's half of a stereo texture
+	vec4 uvScaleBias[2];
+};
+// the eye this pass renders
+uniform int eye;
 
 
 void main()
 {
-	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
-	gl_Position = mvp * vec4(aPos, 1.0f);
+	TexCoord = aTexCoord * uvScaleBias[eye].xy + uvScaleBias[eye].zw;
+	EyeRect = vec4(uvScaleBias[eye].zw, uvScaleBias[eye].zw + uvScaleBias[eye].xy);
+	gl_Position = mvp[eye] * vec4(aPos, 1.0f);
 }
\ No newline at end of file
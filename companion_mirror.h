@@ -0,0 +1,107 @@
+#ifndef COMPANION_MIRROR_H
+#define COMPANION_MIRROR_H
+
+#include <glad/glad.h>
+
+#include "eye_targets.h"
+
+#include <algorithm>
+
+// Window sized copies of the eye buffers for the companion window. Refreshed at its own rate,
+// independent of the compositor, so the desktop view costs the headset one downsampling blit
+// per refresh instead of drawing the full size eye buffers every frame.
+class CompanionMirror
+{
+public:
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLuint texture[2] = {0, 0};
+
+    // companion frames per second, 0 for only those asked for with request()
+    float rate = 30.0f;
+
+    CompanionMirror() {}
+    CompanionMirror(const CompanionMirror&) = delete;
+    CompanionMirror& operator=(const CompanionMirror&) = delete;
+
+    ~CompanionMirror()
+    {
+        destroy();
+    }
+
+    void create(GLsizei width, GLsizei height)
+    {
+        destroy();
+        this->width = width;
+        this->height = height;
+
+        for (GLuint &eyeTexture : texture) {
+            glGenTextures(1, &eyeTexture);
+            glBindTexture(GL_TEXTURE_2D, eyeTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &readFbo);
+        glGenFramebuffers(1, &drawFbo);
+    }
+
+    void destroy()
+    {
+        glDeleteTextures(2, texture);
+        glDeleteFramebuffers(1, &readFbo);
+        glDeleteFramebuffers(1, &drawFbo);
+        texture[0] = texture[1] = 0;
+        readFbo = drawFbo = 0;
+    }
+
+    // the next due() is true regardless of rate
+    void request()
+    {
+        requested = true;
+    }
+
+    // whether the companion window is due a new frame at time, in seconds
+    bool due(double time) const
+    {
+        return requested || (rate > 0.0f && time - lastPresented >= 1.0 / rate);
+    }
+
+    // how long the window can wait before it is due, for sleeping when nothing else paces the loop
+    double secondsUntilDue(double time, double idle) const
+    {
+        if (requested)
+            return 0.0;
+        if (rate <= 0.0f)
+            return idle;
+        return std::max(0.0, lastPresented + 1.0 / rate - time);
+    }
+
+    void presented(double time)
+    {
+        lastPresented = time;
+        requested = false;
+    }
+
+    // Downsamples the bottom left regionWidth x regionHeight of both eyes into texture
+    void update(const EyeTargets &eyes, GLsizei regionWidth, GLsizei regionHeight)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+        for (int eye = 0; eye < 2; eye++) {
+            eyes.attachForRead(eye);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture[eye], 0);
+            glBlitFramebuffer(0, 0, regionWidth, regionHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    GLuint readFbo = 0;
+    GLuint drawFbo = 0;
+    bool requested = false;
+    double lastPresented = -1.0e9;
+};
+#endif
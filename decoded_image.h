@@ -0,0 +1,71 @@
+#ifndef DECODED_IMAGE_H
+#define DECODED_IMAGE_H
+
+#include "opencv2/opencv.hpp"
+#include "mip_builder.h"
+
+#include <string>
+#include <chrono>
+#include <memory>
+
+// How the two eye views are packed into a single stereo image
+enum StereoLayout {
+    SIDE_BY_SIDE,
+    TOP_BOTTOM
+};
+
+// What to decode a stereo image as. scale is 1, 2, 4 or 8, decoding at 1/scale resolution.
+struct DecodeOptions
+{
+    StereoLayout layout = SIDE_BY_SIDE;
+    int scale = 1;
+};
+
+// A decoded 8-bit stereo image, ready to be uploaded on the GL thread without any conversion.
+// Pixels are in OpenCV's BGR order unless rgbOrder is set.
+// The whole pair is kept in one Mat so it can be uploaded as a single texture, it is only
+// split into per-eye ROIs (views into the decoded buffer, not copies) when it would not fit
+// within GL_MAX_TEXTURE_SIZE.
+struct DecodedImage
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::string path;
+    std::string cacheKey;
+    StereoLayout layout = SIDE_BY_SIDE;
+    cv::Mat image;
+    cv::Mat left;
+    cv::Mat right;
+    bool rgbOrder = false;
+
+    // resolution divisor it was decoded at, and the width of one eye at full resolution
+    int decodeScale = 1;
+    int sourceEyeWidth = 0;
+
+    // levels 1..n for whichever of image or left/right is in use
+    MipChain imageMips;
+    MipChain leftMips;
+    MipChain rightMips;
+
+    // keeps pixel memory the Mats do not own alive, e.g. a baked file mapping
+    std::shared_ptr<void> storage;
+
+    // for load-to-first-frame measurements
+    Clock::time_point requested;
+    double decodeMs = 0.0;
+    double mipMs = 0.0;
+
+    bool isSplit() const { return image.empty(); }
+
+    // CPU memory held by the pixel buffers, a split pair shares one parent buffer
+    size_t bytes() const
+    {
+        const cv::Mat &base = isSplit() ? left : image;
+        size_t total = base.empty() ? 0 : (size_t) (base.dataend - base.datastart);
+        for (const MipChain *chain : {&imageMips, &leftMips, &rightMips})
+            for (const cv::Mat &mip : *chain)
+                total += mip.total() * mip.elemSize();
+        return total;
+    }
+};
+#endif
@@ -0,0 +1,79 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+// Picks the fraction of the eye buffers to render each frame from measured GPU frame times.
+// Shrinks as soon as the smoothed GPU time goes over budget, grows back a step at a time once
+// there has been headroom for a while, so it does not oscillate around the limit.
+class DynamicResolution
+{
+public:
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // share of the frame interval the app may spend on the GPU, the compositor needs the rest
+    float budgetFraction = 0.8f;
+    // grow once the GPU time stayed under growThreshold * budget for growFrames frames
+    float growThreshold = 0.7f;
+    int growFrames = 45;
+    float growStep = 0.05f;
+
+    void setDisplayFrequency(float hz)
+    {
+        if (hz > 0.0f)
+            frameIntervalMs = 1000.0f / hz;
+    }
+
+    float budgetMs() const
+    {
+        return frameIntervalMs * budgetFraction;
+    }
+
+    float scale() const { return current; }
+    float gpuMs() const { return smoothedMs; }
+
+    void reset()
+    {
+        current = maxScale;
+        smoothedMs = 0.0f;
+        framesUnder = 0;
+    }
+
+    // frameGpuMs: GPU time of the app's last frame, rendered at the current scale
+    void update(float frameGpuMs)
+    {
+        if (frameGpuMs <= 0.0f)
+            return;
+        smoothedMs = smoothedMs > 0.0f ? smoothedMs * 0.8f + frameGpuMs * 0.2f : frameGpuMs;
+
+        float budget = budgetMs();
+        if (smoothedMs > budget && current > minScale) {
+            // GPU time follows the pixel count, which goes with the square of the scale
+            setScale(current * std::sqrt(budget / smoothedMs));
+            framesUnder = 0;
+        } else if (smoothedMs < budget * growThreshold && current < maxScale) {
+            if (++framesUnder >= growFrames) {
+                setScale(current + growStep);
+                framesUnder = 0;
+            }
+        } else {
+            framesUnder = 0;
+        }
+    }
+
+private:
+    float frameIntervalMs = 1000.0f / 90.0f;
+    float current = 1.0f;
+    float smoothedMs = 0.0f;
+    int framesUnder = 0;
+
+    void setScale(float scale)
+    {
+        scale = std::clamp(scale, minScale, maxScale);
+        // predict the new GPU time so the average does not trigger a second step on stale frames
+        smoothedMs *= (scale * scale) / (current * current);
+        current = scale;
+    }
+};
+#endif
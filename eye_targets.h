@@ -0,0 +1,161 @@
+#ifndef EYE_TARGETS_H
+#define EYE_TARGETS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "openvr.h"
+
+#include <cstring>
+#include <iostream>
+
+// How both eyes get rendered each frame
+enum StereoRenderMode {
+    // one pass per eye into its own texture, re-attached to a shared FBO
+    RENDER_MULTI_PASS,
+    // one instanced draw into a 2 layer array texture, a geometry shader routes each instance to its layer
+    RENDER_SINGLE_PASS_LAYERED,
+    // one draw into a 2 layer array texture through GL_OVR_multiview2
+    RENDER_SINGLE_PASS_MULTIVIEW
+};
+
+typedef void (APIENTRYP PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)(GLenum target, GLenum attachment, GLuint texture,
+                                                               GLint level, GLint baseViewIndex, GLsizei numViews);
+
+inline bool hasGLExtension(const char* name){
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// The render targets of both eyes for any StereoRenderMode: eyeTexture in multi pass mode, the
+// two layers of colorArray in the single pass modes.
+class EyeTargets
+{
+public:
+    StereoRenderMode mode = RENDER_MULTI_PASS;
+    GLsizei width = 0;
+    GLsizei height = 0;
+
+    GLuint fbo = 0;
+    GLuint eyeTexture[2] = {0, 0};
+    GLuint colorArray = 0;
+    GLuint depthArray = 0;
+    GLuint depthBuffer = 0;
+
+    // multiview falls back to the layered mode when GL_OVR_multiview2 is missing
+    void create(StereoRenderMode requested, GLsizei width, GLsizei height)
+    {
+        destroy();
+        this->width = width;
+        this->height = height;
+
+        if (requested == RENDER_SINGLE_PASS_MULTIVIEW) {
+            framebufferTextureMultiview = (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC) glfwGetProcAddress("glFramebufferTextureMultiviewOVR");
+            if (!framebufferTextureMultiview || !hasGLExtension("GL_OVR_multiview2")) {
+                std::cout << "GL_OVR_multiview2 not supported, using layered rendering" << std::endl;
+                requested = RENDER_SINGLE_PASS_LAYERED;
+            }
+        }
+        mode = requested;
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+        if (mode == RENDER_MULTI_PASS) {
+            glGenRenderbuffers(1, &depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+            for (GLuint &texture : eyeTexture) {
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+
+        glGenTextures(1, &colorArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, colorArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+        glGenTextures(1, &depthArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH24_STENCIL8, width, height, 2, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        if (mode == RENDER_SINGLE_PASS_MULTIVIEW) {
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorArray, 0, 0, 2);
+            framebufferTextureMultiview(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, depthArray, 0, 0, 2);
+        } else {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorArray, 0);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, depthArray, 0);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::EYE_TARGETS::LAYERED_FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroy()
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(2, eyeTexture);
+        glDeleteTextures(1, &colorArray);
+        glDeleteTextures(1, &depthArray);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = colorArray = depthArray = depthBuffer = 0;
+        eyeTexture[0] = eyeTexture[1] = 0;
+    }
+
+    bool singlePass() const
+    {
+        return mode != RENDER_MULTI_PASS;
+    }
+
+    // binds the FBO, in multi pass mode with the given eye's texture attached
+    void bind(int eye = 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        if (mode == RENDER_MULTI_PASS)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, eyeTexture[eye], 0);
+    }
+
+    // Attaches an eye's color image to the bound GL_READ_FRAMEBUFFER, e.g. to blit from it
+    void attachForRead(int eye) const
+    {
+        if (mode == RENDER_MULTI_PASS)
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, eyeTexture[eye], 0);
+        else
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorArray, 0, eye);
+    }
+
+    // texture handed to the compositor for an eye, submitted with submitFlags()
+    GLuint submitTexture(int eye) const
+    {
+        return mode == RENDER_MULTI_PASS ? eyeTexture[eye] : colorArray;
+    }
+
+    vr::EVRSubmitFlags submitFlags() const
+    {
+        // with an array texture the compositor reads the layer matching the eye index
+        return mode == RENDER_MULTI_PASS ? vr::Submit_Default : vr::Submit_GlArrayTexture;
+    }
+
+private:
+    PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC framebufferTextureMultiview = nullptr;
+};
+#endif
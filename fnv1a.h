@@ -0,0 +1,17 @@
+#ifndef FNV1A_H
+#define FNV1A_H
+
+#include <cstdint>
+#include <string>
+
+// Stable across runs and platforms, unlike std::hash
+inline uint64_t fnv1a64(const std::string &text, uint64_t hash = 1469598103934665603ull)
+{
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+#endif
@@ -0,0 +1,80 @@
+#ifndef FRAME_REUSE_H
+#define FRAME_REUSE_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Everything the eye buffers depend on. Two frames with matching state render the same pixels,
+// up to head motion small enough for the compositor to reproject.
+struct FrameState
+{
+    // HMD device to tracking space, not inverted
+    glm::mat4 headPose = glm::mat4(0.0f);
+    // projection * eye to head of each eye
+    glm::mat4 eyeProjection[2] = {glm::mat4(0.0f), glm::mat4(0.0f)};
+    glm::mat4 model = glm::mat4(0.0f);
+    GLuint texture[2] = {0, 0};
+    glm::vec4 uvScaleBias[2];
+    GLsizei viewportWidth = 0;
+    GLsizei viewportHeight = 0;
+};
+
+// Decides whether the last rendered eye buffers can be submitted again instead of redrawing a
+// still image. The old buffers go out with the pose they were rendered at, so the compositor
+// reprojects them onto the current head pose.
+class FrameReuse
+{
+public:
+    float maxTranslation = 0.0005f; // metres
+    float maxRotationDegrees = 0.05f;
+
+    // true when state renders like the last rendered frame
+    bool canReuse(const FrameState &state) const
+    {
+        if (!valid)
+            return false;
+        for (int eye = 0; eye < 2; eye++) {
+            if (state.eyeProjection[eye] != last.eyeProjection[eye] || state.texture[eye] != last.texture[eye] ||
+                state.uvScaleBias[eye] != last.uvScaleBias[eye])
+                return false;
+        }
+        if (state.model != last.model || state.viewportWidth != last.viewportWidth || state.viewportHeight != last.viewportHeight)
+            return false;
+        return poseClose(state.headPose, last.headPose);
+    }
+
+    void rendered(const FrameState &state)
+    {
+        last = state;
+        valid = true;
+    }
+
+    // forces the next frame to render, e.g. after the eye buffers were recreated
+    void invalidate()
+    {
+        valid = false;
+    }
+
+    const FrameState &lastRendered() const
+    {
+        return last;
+    }
+
+private:
+    FrameState last;
+    bool valid = false;
+
+    bool poseClose(const glm::mat4 &a, const glm::mat4 &b) const
+    {
+        if (glm::length(glm::vec3(a[3]) - glm::vec3(b[3])) > maxTranslation)
+            return false;
+        // angle of the relative rotation, from the trace of a^T * b
+        glm::mat3 relative = glm::transpose(glm::mat3(a)) * glm::mat3(b);
+        float cosine = std::clamp((relative[0][0] + relative[1][1] + relative[2][2] - 1.0f) * 0.5f, -1.0f, 1.0f);
+        return glm::degrees(std::acos(cosine)) <= maxRotationDegrees;
+    }
+};
+#endif
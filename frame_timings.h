@@ -0,0 +1,185 @@
+#ifndef FRAME_TIMINGS_H
+#define FRAME_TIMINGS_H
+
+#include "openvr.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// The compositor's view of our recent frames, from IVRCompositor::GetFrameTimings, in a fixed
+// size ring. collect() runs once per frame and takes every frame that finished since the last
+// call, so no frame is missed even when the loop falls behind by a few.
+class FrameTimings
+{
+public:
+    static const int CAPACITY = 1024;
+
+    struct Sample
+    {
+        uint32_t frameIndex = 0;
+        double systemSeconds = 0.0;
+        float preSubmitGpuMs = 0.0f;
+        float postSubmitGpuMs = 0.0f;
+        float compositorGpuMs = 0.0f;
+        float clientIntervalMs = 0.0f;
+        uint32_t presents = 0;
+        uint32_t misPresented = 0;
+        uint32_t dropped = 0;
+        uint32_t reprojectionFlags = 0;
+
+        float gpuMs() const
+        {
+            return preSubmitGpuMs + postSubmitGpuMs;
+        }
+
+        // shown more than once or reprojected for missing its deadline
+        bool reprojected() const
+        {
+            return presents > 1 ||
+                   (reprojectionFlags & (vr::VRCompositor_ReprojectionReason_Cpu | vr::VRCompositor_ReprojectionReason_Gpu)) != 0;
+        }
+    };
+
+    struct Summary
+    {
+        int frames = 0;
+        float gpuP50 = 0.0f, gpuP90 = 0.0f, gpuP99 = 0.0f;
+        float intervalP50 = 0.0f, intervalP99 = 0.0f;
+        float reprojectionRatio = 0.0f;
+        int reprojected = 0;
+        int dropped = 0;
+        int misPresented = 0;
+    };
+
+    // returns how many frames were new, the newest is then latest()
+    int collect(vr::IVRCompositor *compositor)
+    {
+        if (!compositor)
+            return 0;
+        vr::Compositor_FrameTiming timings[FETCH];
+        timings[0].m_nSize = sizeof(vr::Compositor_FrameTiming);
+        uint32_t count = compositor->GetFrameTimings(timings, FETCH);
+
+        // oldest first; the newest entry is the frame still in flight, its GPU times are not in yet
+        int added = 0;
+        for (uint32_t i = 0; i + 1 < count; i++) {
+            const vr::Compositor_FrameTiming &timing = timings[i];
+            if (size > 0 && timing.m_nFrameIndex <= latest().frameIndex)
+                continue;
+            Sample sample;
+            sample.frameIndex = timing.m_nFrameIndex;
+            sample.systemSeconds = timing.m_flSystemTimeInSeconds;
+            sample.preSubmitGpuMs = timing.m_flPreSubmitGpuMs;
+            sample.postSubmitGpuMs = timing.m_flPostSubmitGpuMs;
+            sample.compositorGpuMs = timing.m_flCompositorRenderGpuMs;
+            sample.clientIntervalMs = timing.m_flClientFrameIntervalMs;
+            sample.presents = timing.m_nNumFramePresents;
+            sample.misPresented = timing.m_nNumMisPresented;
+            sample.dropped = timing.m_nNumDroppedFrames;
+            sample.reprojectionFlags = timing.m_nReprojectionFlags;
+            push(sample);
+            added++;
+        }
+        return added;
+    }
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    const Sample &latest() const
+    {
+        return samples[(head + CAPACITY - 1) % CAPACITY];
+    }
+
+    // i = 0 is the oldest sample still held
+    const Sample &at(int i) const
+    {
+        return samples[(head + CAPACITY - size + i) % CAPACITY];
+    }
+
+    int count() const
+    {
+        return size;
+    }
+
+    // over the frames in the ring
+    Summary summarize() const
+    {
+        Summary summary;
+        summary.frames = size;
+        if (size == 0)
+            return summary;
+
+        std::vector<float> gpu, interval;
+        for (int i = 0; i < size; i++) {
+            const Sample &sample = at(i);
+            gpu.push_back(sample.gpuMs());
+            interval.push_back(sample.clientIntervalMs);
+            summary.reprojected += sample.reprojected();
+            summary.dropped += sample.dropped;
+            summary.misPresented += sample.misPresented;
+        }
+        summary.gpuP50 = percentile(gpu, 50);
+        summary.gpuP90 = percentile(gpu, 90);
+        summary.gpuP99 = percentile(gpu, 99);
+        summary.intervalP50 = percentile(interval, 50);
+        summary.intervalP99 = percentile(interval, 99);
+        summary.reprojectionRatio = (float) summary.reprojected / size;
+        return summary;
+    }
+
+    // field of every sample, oldest first, e.g. for ImGui::PlotLines
+    std::vector<float> series(float Sample::*field) const
+    {
+        std::vector<float> values;
+        values.reserve(size);
+        for (int i = 0; i < size; i++)
+            values.push_back(at(i).*field);
+        return values;
+    }
+
+    bool writeCsv(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+            return false;
+        out << "frame,system_s,pre_submit_gpu_ms,post_submit_gpu_ms,compositor_gpu_ms,client_interval_ms,"
+               "presents,mispresented,dropped,reprojection_flags\n";
+        for (int i = 0; i < size; i++) {
+            const Sample &sample = at(i);
+            out << sample.frameIndex << "," << sample.systemSeconds << "," << sample.preSubmitGpuMs << ","
+                << sample.postSubmitGpuMs << "," << sample.compositorGpuMs << "," << sample.clientIntervalMs << ","
+                << sample.presents << "," << sample.misPresented << "," << sample.dropped << ","
+                << sample.reprojectionFlags << "\n";
+        }
+        return (bool) out;
+    }
+
+private:
+    // frames fetched per collect(), the loop may fall this far behind without losing any
+    static const uint32_t FETCH = 16;
+
+    Sample samples[CAPACITY];
+    int head = 0;
+    int size = 0;
+
+    void push(const Sample &sample)
+    {
+        samples[head] = sample;
+        head = (head + 1) % CAPACITY;
+        size = std::min(size + 1, CAPACITY);
+    }
+
+    static float percentile(std::vector<float> values, int percent)
+    {
+        size_t index = std::min(values.size() - 1, values.size() * percent / 100);
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+};
+#endif
@@ -0,0 +1,236 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// GPU time of named passes from GL_TIME_ELAPSED queries. Each pass owns a ring of queries that
+// are read back a few frames late, once available, so measuring never stalls the pipeline. The
+// ring grows when results fall further behind than it holds, so no run of a pass goes unmeasured.
+// Results are summed per frame (a pass may run once per eye) and the last HISTORY frames are
+// kept for rolling statistics and CSV dumps.
+//
+// Time elapsed queries do not nest: passes must not overlap.
+class GpuProfiler
+{
+public:
+    // initial queries per pass: frames a result may take to arrive, times the runs per frame
+    static const int QUERIES = 8;
+    static const int HISTORY = 240;
+
+    struct Stats
+    {
+        double min = 0.0;
+        double avg = 0.0;
+        double p99 = 0.0;
+        double last = 0.0;
+        int frames = 0;
+    };
+
+    GpuProfiler() {}
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // call destroy() while the context is still current, this only catches a missed one
+    ~GpuProfiler()
+    {
+        destroy();
+    }
+
+    // deletes every query, passes have to be registered again afterwards
+    void destroy()
+    {
+        for (Pass &pass : passes)
+            glDeleteQueries((GLsizei) pass.queries.size(), pass.queries.data());
+        passes.clear();
+        pendingFrames.clear();
+        history.clear();
+    }
+
+    // index of the pass called name, registered on first use
+    int pass(const std::string &name)
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+            if (passes[i].name == name)
+                return (int) i;
+        passes.emplace_back();
+        Pass &state = passes.back();
+        state.name = name;
+        state.queries.resize(QUERIES);
+        state.frame.resize(QUERIES);
+        state.pending.resize(QUERIES);
+        glGenQueries(QUERIES, state.queries.data());
+        return (int) passes.size() - 1;
+    }
+
+    size_t passCount() const
+    {
+        return passes.size();
+    }
+
+    const std::string &name(int pass) const
+    {
+        return passes[pass].name;
+    }
+
+    // collects whatever finished since the last frame
+    void beginFrame()
+    {
+        for (size_t i = 0; i < passes.size(); i++)
+            collect((int) i);
+        pendingFrames.emplace_back();
+        pendingFrames.back().frame = frame;
+    }
+
+    void begin(int pass)
+    {
+        running = pendingFrames.empty() ? -1 : pass;
+        if (running < 0)
+            return;
+        Pass &state = passes[pass];
+        // Every query is still waiting for its result: a new one goes in ahead of the oldest,
+        // which keeps the ring in submission order
+        if (state.pending[state.next]) {
+            GLuint query;
+            glGenQueries(1, &query);
+            state.queries.insert(state.queries.begin() + state.next, query);
+            state.frame.insert(state.frame.begin() + state.next, 0);
+            state.pending.insert(state.pending.begin() + state.next, false);
+        }
+        glBeginQuery(GL_TIME_ELAPSED, state.queries[state.next]);
+    }
+
+    void end(int pass)
+    {
+        if (running != pass)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        Pass &state = passes[pass];
+        state.pending[state.next] = true;
+        state.frame[state.next] = frame;
+        state.next = (state.next + 1) % (int) state.queries.size();
+        pendingFrames.back().queries++;
+        running = -1;
+    }
+
+    // closes the frame, those with all results in move to the history
+    void endFrame()
+    {
+        if (!pendingFrames.empty())
+            pendingFrames.back().ended = true;
+        while (!pendingFrames.empty() && pendingFrames.front().ended && pendingFrames.front().queries == 0) {
+            history.push_back(pendingFrames.front());
+            pendingFrames.pop_front();
+            if (history.size() > HISTORY)
+                history.pop_front();
+        }
+        frame++;
+    }
+
+    // over the frames in the history that ran the pass
+    Stats stats(int pass) const
+    {
+        Stats result;
+        std::vector<double> times;
+        for (const Frame &record : history)
+            if ((size_t) pass < record.ms.size() && record.ms[pass] >= 0.0)
+                times.push_back(record.ms[pass]);
+        if (times.empty())
+            return result;
+
+        result.last = times.back();
+        result.frames = (int) times.size();
+        double sum = 0.0;
+        for (double time : times)
+            sum += time;
+        result.avg = sum / times.size();
+        std::sort(times.begin(), times.end());
+        result.min = times.front();
+        result.p99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+        return result;
+    }
+
+    // Writes the history as one row per frame, a column per pass in ms; empty where a pass
+    // did not run
+    bool writeCsv(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+            return false;
+        out << "frame";
+        for (const Pass &state : passes)
+            out << "," << state.name;
+        out << "\n";
+        for (const Frame &record : history) {
+            out << record.frame;
+            for (size_t i = 0; i < passes.size(); i++) {
+                out << ",";
+                if (i < record.ms.size() && record.ms[i] >= 0.0)
+                    out << record.ms[i];
+            }
+            out << "\n";
+        }
+        return (bool) out;
+    }
+
+private:
+    // a ring per pass, next is the slot used next and, when pending, the oldest query in flight
+    struct Pass
+    {
+        std::string name;
+        std::vector<GLuint> queries;
+        std::vector<long> frame;
+        std::vector<char> pending;
+        int next = 0;
+    };
+
+    struct Frame
+    {
+        long frame = 0;
+        // per pass, -1 where it did not run
+        std::vector<double> ms;
+        int queries = 0;
+        bool ended = false;
+    };
+
+    std::vector<Pass> passes;
+    std::deque<Frame> pendingFrames;
+    std::deque<Frame> history;
+    long frame = 0;
+    int running = -1;
+
+    void collect(int pass)
+    {
+        // oldest first, results arrive in submission order
+        Pass &state = passes[pass];
+        int size = (int) state.queries.size();
+        for (int i = 0; i < size; i++) {
+            int index = (state.next + i) % size;
+            if (!state.pending[index])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(state.queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(state.queries[index], GL_QUERY_RESULT, &nanoseconds);
+            state.pending[index] = false;
+
+            for (Frame &record : pendingFrames) {
+                if (record.frame != state.frame[index])
+                    continue;
+                if (record.ms.size() < passes.size())
+                    record.ms.resize(passes.size(), -1.0);
+                record.ms[pass] = std::max(record.ms[pass], 0.0) + nanoseconds / 1.0e6;
+                record.queries--;
+                break;
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,17 @@
+#version 330 core
+// Sends each triangle to the array layer of its eye, ignored on non layered framebuffers
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+flat in int vEye[];
+
+void main()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Layer = vEye[i];
+		gl_Position = gl_in[i].gl_Position;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
\ No newline at end of file
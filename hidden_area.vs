@@ -0,0 +1,11 @@
+#version 330 core
+// aPos.xy: position in the eye texture, [0, 1] with v running down; aPos.z: eye
+layout (location = 0) in vec3 aPos;
+
+flat out int vEye;
+
+void main()
+{
+	vEye = int(aPos.z);
+	gl_Position = vec4(aPos.x * 2.0f - 1.0f, 1.0f - aPos.y * 2.0f, 0.0f, 1.0f);
+}
\ No newline at end of file
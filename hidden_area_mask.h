@@ -0,0 +1,146 @@
+#ifndef HIDDEN_AREA_MASK_H
+#define HIDDEN_AREA_MASK_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "openvr.h"
+
+#include "shader.h"
+
+#include <memory>
+#include <vector>
+
+// The parts of the eye buffers the lenses never show, from IVRSystem::GetHiddenAreaMesh.
+// clear() marks them in the stencil buffer and fills only the visible rest, later draws then
+// run with the stencil test rejecting the hidden pixels.
+//
+// One vertex buffer holds, as (u, v, eye): the hidden triangles of the left then the right eye,
+// followed by a full screen triangle per eye used for the fill.
+class HiddenAreaMask
+{
+public:
+    HiddenAreaMask() {}
+    HiddenAreaMask(const HiddenAreaMask&) = delete;
+    HiddenAreaMask& operator=(const HiddenAreaMask&) = delete;
+
+    // call destroy() while the context is still current, this only catches a missed one
+    ~HiddenAreaMask()
+    {
+        destroy();
+    }
+
+    void create(bool multiview)
+    {
+        this->multiview = multiview;
+        if (multiview)
+            shader.reset(new Shader("../hidden_area_multiview.vs", "../hidden_area.fs"));
+        else
+            shader.reset(new Shader("../hidden_area.vs", "../hidden_area.fs", "../hidden_area.gs"));
+        colorLocation = shader->location("color");
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+    }
+
+    void destroy()
+    {
+        if (!vao)
+            return;
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        vao = vbo = 0;
+        shader.reset();
+        meshVertices[0] = meshVertices[1] = 0;
+    }
+
+    // (Re)reads both meshes from the runtime, needed again after IPD or lens changes
+    bool load()
+    {
+        meshVertices[0] = meshVertices[1] = 0;
+        if (!vbo || !vr::VRSystem())
+            return false;
+
+        std::vector<float> vertices;
+        for (int eye = 0; eye < 2; eye++) {
+            vr::HiddenAreaMesh_t mesh = vr::VRSystem()->GetHiddenAreaMesh((vr::EVREye) eye, vr::k_eHiddenAreaMesh_Standard);
+            for (uint32_t i = 0; mesh.pVertexData && i < mesh.unTriangleCount * 3; i++) {
+                vertices.push_back(mesh.pVertexData[i].v[0]);
+                vertices.push_back(mesh.pVertexData[i].v[1]);
+                vertices.push_back((float) eye);
+            }
+            meshVertices[eye] = mesh.pVertexData ? (GLsizei) mesh.unTriangleCount * 3 : 0;
+        }
+        for (int eye = 0; eye < 2; eye++) {
+            // corners at uv (0, 0), (2, 0) and (0, 2) cover the whole target
+            const float fill[] = {0.0f, 0.0f, (float) eye, 2.0f, 0.0f, (float) eye, 0.0f, 2.0f, (float) eye};
+            vertices.insert(vertices.end(), fill, fill + 9);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        return !empty();
+    }
+
+    bool empty() const
+    {
+        return meshVertices[0] == 0 && meshVertices[1] == 0;
+    }
+
+    // Clears the bound eye target to color outside the hidden area and leaves the stencil test
+    // on, passing visible pixels only. eye < 0 covers both layers of a layered target.
+    void clear(int eye, const glm::vec4 &color)
+    {
+        glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+
+        shader->use();
+        glBindVertexArray(vao);
+
+        // hidden area: stencil 1, no color
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        if (eye < 0)
+            glDrawArrays(GL_TRIANGLES, 0, meshVertices[0] + meshVertices[1]);
+        else
+            glDrawArrays(GL_TRIANGLES, eye == 0 ? 0 : meshVertices[0], meshVertices[eye]);
+
+        // everything else: the clear color
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilFunc(GL_EQUAL, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        shader->setVec4(colorLocation, color);
+        GLint fillStart = meshVertices[0] + meshVertices[1];
+        if (eye < 0)
+            glDrawArrays(GL_TRIANGLES, fillStart, 6);
+        else
+            glDrawArrays(GL_TRIANGLES, fillStart + eye * 3, 3);
+
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    // ends the masked drawing started by clear()
+    void end()
+    {
+        glDisable(GL_STENCIL_TEST);
+    }
+
+private:
+    bool multiview = false;
+    std::unique_ptr<Shader> shader;
+    GLint colorLocation = -1;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLsizei meshVertices[2] = {0, 0};
+};
+#endif
@@ -0,0 +1,13 @@
+#version 330 core
+#extension GL_OVR_multiview2 : require
+// Every view sees the triangles of both eyes, the other eye's get pushed out of the clip volume
+layout (num_views = 2) in;
+layout (location = 0) in vec3 aPos;
+
+void main()
+{
+	if (int(aPos.z) != int(gl_ViewID_OVR))
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+	else
+		gl_Position = vec4(aPos.x * 2.0f - 1.0f, 1.0f - aPos.y * 2.0f, 0.0f, 1.0f);
+}
\ No newline at end of file
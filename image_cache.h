@@ -0,0 +1,171 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <filesystem>
+#include <sstream>
+
+struct CacheStats
+{
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+};
+
+// Least recently used cache with a byte budget. Values are reported with their size when
+// inserted, onEvict runs for every value that is pushed out (e.g. to free GL textures).
+// Thread safe, the loader thread and the render thread may share one instance.
+template <class Value>
+class LruCache
+{
+public:
+    LruCache(size_t budget = 0, std::function<void(Value&)> onEvict = nullptr)
+        : budget(budget), onEvict(onEvict) {}
+
+    ~LruCache()
+    {
+        clear();
+    }
+
+    void setBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        trim();
+    }
+
+    // copies the value out and marks it most recently used
+    bool get(const std::string &key, Value &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            stats.misses++;
+            return false;
+        }
+        stats.hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        out = it->second->value;
+        return true;
+    }
+
+    bool contains(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return index.count(key) != 0;
+    }
+
+    // removes the entry without evicting it, ownership goes back to the caller
+    bool take(const std::string &key, Value &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            stats.misses++;
+            return false;
+        }
+        stats.hits++;
+        out = it->second->value;
+        stats.bytes -= it->second->bytes;
+        entries.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    // returns false (and leaves the value with the caller) if it can never fit the budget
+    bool put(const std::string &key, const Value &value, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (key.empty() || bytes > budget)
+            return false;
+
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            stats.bytes -= it->second->bytes;
+            evict(it->second);
+        }
+
+        entries.push_front(Entry{key, value, bytes});
+        index[key] = entries.begin();
+        stats.bytes += bytes;
+        trim();
+        return true;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!entries.empty())
+        {
+            stats.bytes -= entries.back().bytes;
+            evict(std::prev(entries.end()));
+        }
+    }
+
+    CacheStats getStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CacheStats result = stats;
+        result.entries = entries.size();
+        result.budget = budget;
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        Value value;
+        size_t bytes;
+    };
+
+    std::list<Entry> entries;
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+    std::mutex mutex;
+    size_t budget;
+    std::function<void(Value&)> onEvict;
+    CacheStats stats;
+
+    void evict(typename std::list<Entry>::iterator it)
+    {
+        if (onEvict)
+            onEvict(it->value);
+        index.erase(it->key);
+        entries.erase(it);
+    }
+
+    void trim()
+    {
+        while (stats.bytes > budget && !entries.empty())
+        {
+            stats.bytes -= entries.back().bytes;
+            stats.evictions++;
+            evict(std::prev(entries.end()));
+        }
+    }
+};
+
+// Identifies a decode result: the same file, unmodified, decoded with the same options.
+// Returns an empty key when the file can not be stat'ed, which is never cached.
+inline std::string makeImageCacheKey(const std::string &path, const std::string &options)
+{
+    std::error_code error;
+    auto mtime = std::filesystem::last_write_time(path, error);
+    if (error)
+        return "";
+
+    std::ostringstream key;
+    key << path << '|' << mtime.time_since_epoch().count() << '|' << options;
+    return key.str();
+}
+#endif
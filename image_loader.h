@@ -0,0 +1,544 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include "opencv2/opencv.hpp"
+#include "decoded_image.h"
+#include "pixel_kernels.h"
+#include "mip_builder.h"
+#include "image_cache.h"
+#include "thread_pool.h"
+#include "baked_texture.h"
+#include "trace.h"
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <memory>
+#include <fstream>
+
+// Optional CPU repack of the decoded BGR pixels, for drivers whose GL_BGR upload path is slow
+enum CpuSwizzle {
+    SWIZZLE_NONE,
+    // same size, uploaded as GL_RGB
+    SWIZZLE_RGB,
+    // a third more memory, uploaded as GL_RGBA
+    SWIZZLE_RGBA
+};
+
+struct ImageLoaderSettings
+{
+    // GL_MAX_TEXTURE_SIZE of the context the result will be uploaded to
+    int maxTextureSize = 0;
+    CpuSwizzle swizzle = SWIZZLE_NONE;
+    MipFilter mipFilter = MIP_FILTER_BOX;
+    // average mip levels in linear light
+    bool srgbMips = false;
+    // budget of the decoded image cache, 0 disables it
+    size_t cacheBytes = 0;
+    // workers decoding prefetched images into the cache
+    unsigned prefetchThreads = 2;
+    // directory of baked textures (see baked_texture.h), empty disables them
+    std::string bakedCacheDir;
+    // bake every image that had to be decoded, so the next launch can map it instead
+    bool bakeOnLoad = false;
+};
+
+// Decodes and splits images on a background thread so the render loop never blocks on cv::imread.
+// Only the most recently requested path is decoded, older pending requests are dropped.
+// Decoded images are kept in an LRU cache so flipping back to a recent image skips the decode,
+// and prefetch() fills that cache ahead of time on a separate pool of workers.
+class ImageLoader
+{
+public:
+    ImageLoader() {}
+
+    // for synchronous use through bake(), without starting any threads
+    explicit ImageLoader(const ImageLoaderSettings &settings) : settings(settings) {}
+
+    ~ImageLoader()
+    {
+        stop();
+    }
+
+    void start(const ImageLoaderSettings &settings)
+    {
+        if (worker.joinable())
+            return;
+        this->settings = settings;
+        cache.setBudget(settings.cacheBytes);
+        if (settings.prefetchThreads > 0)
+            prefetchPool.reset(new ThreadPool(settings.prefetchThreads, "Prefetch"));
+        quit = false;
+        worker = std::thread(&ImageLoader::run, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        loaded.notify_all();
+        if (worker.joinable())
+            worker.join();
+        prefetchPool.reset();
+    }
+
+    // queue a path for decoding, replacing whatever was queued before
+    // ------------------------------------------------------------------------
+    void request(const std::string &path, const DecodeOptions &options = DecodeOptions())
+    {
+        queue(path, options, -1);
+    }
+
+    // Same, but the decode scale is picked on the loader thread from the file header, the
+    // coarsest that still leaves targetEyeWidth pixels per eye (see decodeOptionsFor)
+    void request(const std::string &path, StereoLayout layout, int targetEyeWidth)
+    {
+        DecodeOptions options;
+        options.layout = layout;
+        queue(path, options, targetEyeWidth);
+    }
+
+    // Decodes paths into the cache in the background, nearest first. Replaces the previous
+    // prefetch set, its queued loads are dropped but ones already running finish.
+    // Each image is decoded at the scale that still gives it targetEyeWidth pixels per eye.
+    // ------------------------------------------------------------------------
+    void prefetch(const std::vector<std::string> &paths, StereoLayout layout, int targetEyeWidth = 0)
+    {
+        if (!prefetchPool || settings.cacheBytes == 0)
+            return;
+
+        prefetchPool->clear();
+        for (const std::string &path : paths)
+        {
+            prefetchPool->submit([this, path, layout, targetEyeWidth] {
+                DecodeOptions options = decodeOptionsFor(path, layout, targetEyeWidth);
+                std::string key = cacheKey(path, options);
+                DecodedImage decoded;
+                if (key.empty() || cache.contains(key) || !beginLoad(key))
+                    return;
+                if (load(path, options, decoded))
+                {
+                    decoded.cacheKey = key;
+                    cache.put(key, decoded, decoded.bytes());
+                }
+                endLoad(key);
+            });
+        }
+    }
+
+    // drops the pending request and any result still in flight
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        hasPending = false;
+        hasReady = false;
+        ready = DecodedImage();
+        generation++;
+    }
+
+    // non-blocking; returns true and moves the decoded image out when one has finished
+    // ------------------------------------------------------------------------
+    bool poll(DecodedImage &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!hasReady)
+            return false;
+        out = std::move(ready);
+        ready = DecodedImage();
+        hasReady = false;
+        return true;
+    }
+
+    bool busy()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hasPending || decoding;
+    }
+
+    // key under which a load of path with the current settings is cached
+    std::string cacheKey(const std::string &path, const DecodeOptions &options) const
+    {
+        std::ostringstream text;
+        text << options.layout << ',' << options.scale << ',' << settings.maxTextureSize << ','
+             << settings.swizzle << ',' << settings.mipFilter << ',' << settings.srgbMips;
+        return makeImageCacheKey(path, text.str());
+    }
+
+    // Baked files do not depend on the GPU they are loaded on, whether one fits
+    // GL_MAX_TEXTURE_SIZE is checked when it is mapped
+    std::string bakedPath(const std::string &path, const DecodeOptions &options) const
+    {
+        std::ostringstream text;
+        text << "baked," << options.layout << ',' << options.scale << ',' << settings.swizzle << ','
+             << settings.mipFilter << ',' << settings.srgbMips;
+        std::string key = makeImageCacheKey(path, text.str());
+        return key.empty() ? "" : bakedTexturePath(settings.bakedCacheDir, key);
+    }
+
+    // decodes path and writes its baked file, synchronously
+    // ------------------------------------------------------------------------
+    bool bake(const std::string &path, const DecodeOptions &options, std::string &bakedFile)
+    {
+        bakedFile = bakedPath(path, options);
+        DecodedImage decoded;
+        if (bakedFile.empty() || !decodeWithMips(path, options, decoded))
+            return false;
+        return writeBakedTexture(bakedFile, decoded);
+    }
+
+    // Picks the coarsest decode scale that still leaves targetEyeWidth pixels per eye.
+    // Only JPEG and PNG headers are read to learn the size, other formats decode in full.
+    // ------------------------------------------------------------------------
+    static DecodeOptions decodeOptionsFor(const std::string &path, StereoLayout layout, int targetEyeWidth)
+    {
+        DecodeOptions options;
+        options.layout = layout;
+        int width, height;
+        if (targetEyeWidth > 0 && readImageSize(path, width, height))
+            options.scale = decodeScaleFor(eyeWidth(width, layout), targetEyeWidth);
+        return options;
+    }
+
+    static int decodeScaleFor(int sourceEyeWidth, int targetEyeWidth)
+    {
+        int scale = 8;
+        while (scale > 1 && sourceEyeWidth / scale < targetEyeWidth)
+            scale /= 2;
+        return scale;
+    }
+
+    static int eyeWidth(int imageWidth, StereoLayout layout)
+    {
+        return layout == SIDE_BY_SIDE ? imageWidth / 2 : imageWidth;
+    }
+
+    // Size from the file header alone, without decoding anything
+    static bool readImageSize(const std::string &path, int &width, int &height)
+    {
+        std::ifstream file(path, std::ios::binary);
+        unsigned char header[24];
+        if (!file.read((char*) header, sizeof(header)))
+            return false;
+
+        // PNG: signature, then the IHDR chunk with big endian width and height
+        if (header[0] == 0x89 && header[1] == 'P' && header[2] == 'N' && header[3] == 'G')
+        {
+            width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+            height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+            return width > 0 && height > 0;
+        }
+
+        // JPEG: walk the marker segments up to the first start-of-frame
+        if (header[0] != 0xFF || header[1] != 0xD8)
+            return false;
+        file.seekg(2);
+        while (file)
+        {
+            int marker = file.get();
+            if (marker != 0xFF)
+                return false;
+            while (marker == 0xFF)
+                marker = file.get();
+            if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+                continue;
+            unsigned char length[2];
+            if (!file.read((char*) length, 2))
+                return false;
+            int segment = (length[0] << 8) | length[1];
+            bool startOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (startOfFrame)
+            {
+                unsigned char frame[5];
+                if (!file.read((char*) frame, 5))
+                    return false;
+                height = (frame[1] << 8) | frame[2];
+                width = (frame[3] << 8) | frame[4];
+                return width > 0 && height > 0;
+            }
+            if (marker == 0xD9 || segment < 2)
+                return false;
+            file.seekg(segment - 2, std::ios::cur);
+        }
+        return false;
+    }
+
+    CacheStats cacheStats()
+    {
+        return cache.getStats();
+    }
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+    ImageLoaderSettings settings;
+
+    std::string pendingPath;
+    DecodeOptions pendingOptions;
+    // >= 0 when pendingOptions.scale is still to be picked for this eye width
+    int pendingTargetEyeWidth = -1;
+    DecodedImage::Clock::time_point pendingRequested;
+    bool hasPending = false;
+    bool decoding = false;
+    unsigned generation = 0;
+
+    LruCache<DecodedImage> cache;
+
+    // keys being decoded right now, so a request and a prefetch never decode the same image twice
+    std::unique_ptr<ThreadPool> prefetchPool;
+    std::set<std::string> loading;
+    std::condition_variable loaded;
+
+    DecodedImage ready;
+    bool hasReady = false;
+
+    void queue(const std::string &path, const DecodeOptions &options, int targetEyeWidth)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingPath = path;
+            pendingOptions = options;
+            pendingTargetEyeWidth = targetEyeWidth;
+            pendingRequested = DecodedImage::Clock::now();
+            hasPending = true;
+            generation++;
+        }
+        wake.notify_one();
+    }
+
+    void run()
+    {
+        trace::setThreadName("Image loader");
+        while (true)
+        {
+            std::string path;
+            DecodeOptions options;
+            int targetEyeWidth;
+            DecodedImage::Clock::time_point requested;
+            unsigned requestGeneration;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quit || hasPending; });
+                if (quit)
+                    return;
+                path = pendingPath;
+                options = pendingOptions;
+                targetEyeWidth = pendingTargetEyeWidth;
+                requested = pendingRequested;
+                requestGeneration = generation;
+                hasPending = false;
+                decoding = true;
+            }
+
+            // header reads and stat calls happen here, never on the render thread
+            if (targetEyeWidth >= 0)
+                options = decodeOptionsFor(path, options.layout, targetEyeWidth);
+            DecodedImage decoded;
+            std::string key = cacheKey(path, options);
+            // a prefetch of this image may already be running, wait for it to land in the cache
+            bool owner = key.empty() || beginLoad(key, true);
+            bool ok = cache.get(key, decoded);
+            if (ok)
+            {
+                decoded.decodeMs = 0.0;
+                decoded.mipMs = 0.0;
+            }
+            else
+            {
+                ok = load(path, options, decoded);
+                if (ok)
+                {
+                    decoded.cacheKey = key;
+                    cache.put(key, decoded, decoded.bytes());
+                }
+            }
+            if (owner && !key.empty())
+                endLoad(key);
+            decoded.requested = requested;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            decoding = false;
+            // a newer request arrived while decoding, this result is already stale
+            if (!ok || requestGeneration != generation)
+                continue;
+            ready = std::move(decoded);
+            hasReady = true;
+        }
+    }
+
+    // Claims key for decoding. With wait set, blocks until a running load of it finishes and then
+    // claims it, otherwise returns false straight away if someone else is loading it.
+    bool beginLoad(const std::string &key, bool wait = false)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait)
+            loaded.wait(lock, [&] { return quit || loading.count(key) == 0; });
+        if (quit || loading.count(key))
+            return false;
+        loading.insert(key);
+        return true;
+    }
+
+    void endLoad(const std::string &key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loading.erase(key);
+        }
+        loaded.notify_all();
+    }
+
+    // everything up to the GL upload, from a baked file when there is one. A reduced decode
+    // without a baked file of its own is served from the matching level of the full one.
+    bool load(const std::string &path, const DecodeOptions &options, DecodedImage &decoded)
+    {
+        std::string bakedFile;
+        if (!settings.bakedCacheDir.empty())
+        {
+            bakedFile = bakedPath(path, options);
+            TRACE_ZONE("Map baked");
+            auto mapStart = DecodedImage::Clock::now();
+            bool mapped = !bakedFile.empty() && mapBakedTexture(bakedFile, settings.maxTextureSize, decoded);
+            if (!mapped && options.scale > 1)
+            {
+                DecodeOptions full = options;
+                full.scale = 1;
+                std::string fullFile = bakedPath(path, full);
+                uint32_t level = 0;
+                while ((1 << level) < options.scale)
+                    level++;
+                mapped = !fullFile.empty() && mapBakedTexture(fullFile, settings.maxTextureSize, decoded, level);
+            }
+            if (mapped)
+            {
+                decoded.path = path;
+                decoded.decodeScale = options.scale;
+                decoded.sourceEyeWidth = (decoded.isSplit() ? decoded.left.cols : eyeWidth(decoded.image.cols, decoded.layout)) * options.scale;
+                decoded.decodeMs = std::chrono::duration<double, std::milli>(DecodedImage::Clock::now() - mapStart).count();
+                return true;
+            }
+        }
+
+        if (!decodeWithMips(path, options, decoded))
+            return false;
+
+        if (settings.bakeOnLoad && !bakedFile.empty() && !writeBakedTexture(bakedFile, decoded))
+            std::cout << "ERROR::IMAGE_LOADER::FAILED_TO_BAKE: " << path << std::endl;
+        return true;
+    }
+
+    // decode plus mip generation
+    bool decodeWithMips(const std::string &path, const DecodeOptions &options, DecodedImage &decoded)
+    {
+        auto decodeStart = DecodedImage::Clock::now();
+        bool ok = decode(path, options, settings, decoded);
+        auto mipStart = DecodedImage::Clock::now();
+        decoded.decodeMs = std::chrono::duration<double, std::milli>(mipStart - decodeStart).count();
+        if (!ok)
+            return false;
+
+        // mip levels are built here so their cost stays off the render thread
+        TRACE_ZONE("Mips");
+        MipBuilder mipBuilder(settings.mipFilter, settings.srgbMips);
+        if (decoded.isSplit())
+        {
+            decoded.leftMips = mipBuilder.build(decoded.left);
+            decoded.rightMips = mipBuilder.build(decoded.right);
+        }
+        else
+        {
+            // each eye's half is filtered on its own, so no level blends the two eyes at the seam
+            cv::Size halves = decoded.layout == SIDE_BY_SIDE ? cv::Size(2, 1) : cv::Size(1, 2);
+            decoded.imageMips = mipBuilder.build(decoded.image, halves);
+        }
+        decoded.mipMs = std::chrono::duration<double, std::milli>(DecodedImage::Clock::now() - mipStart).count();
+        return true;
+    }
+
+    // Runs a pixel kernel over every row of src into a new Mat, rows are split across OpenCV's thread pool
+    static cv::Mat repack(const cv::Mat &src, int dstType, PixelRowKernel kernel, int rowWidth)
+    {
+        cv::Mat dst(src.rows, src.cols, dstType);
+        cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range &range) {
+            convertPixels(kernel, src.ptr(range.start), src.step[0], dst.ptr(range.start), dst.step[0],
+                          rowWidth, range.end - range.start);
+        });
+        return dst;
+    }
+
+    static bool decode(const std::string &path, const DecodeOptions &options, const ImageLoaderSettings &settings,
+                       DecodedImage &out)
+    {
+        // reduced decodes let libjpeg scale in the DCT, which is much cheaper than a full decode
+        int flags = cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH;
+        if (options.scale == 2)
+            flags = cv::IMREAD_REDUCED_COLOR_2;
+        else if (options.scale == 4)
+            flags = cv::IMREAD_REDUCED_COLOR_4;
+        else if (options.scale == 8)
+            flags = cv::IMREAD_REDUCED_COLOR_8;
+
+        TRACE_ZONE("Decode");
+        cv::Mat image = cv::imread(path, flags);
+        if (image.empty())
+        {
+            std::cout << "ERROR::IMAGE_LOADER::FAILED_TO_READ: " << path << std::endl;
+            return false;
+        }
+
+        // 16-bit PNG/TIFF sources are reduced to 8 bits per channel for upload
+        if (image.depth() == CV_16U)
+            image = repack(image, CV_8UC3, depth16To8Kernel(), image.cols * image.channels());
+
+        if (settings.swizzle == SWIZZLE_RGBA)
+        {
+            image = repack(image, CV_8UC4, bgrToRgbaKernel(), image.cols);
+            out.rgbOrder = true;
+        }
+        else if (settings.swizzle == SWIZZLE_RGB)
+        {
+            image = repack(image, CV_8UC3, bgrToRgbKernel(), image.cols);
+            out.rgbOrder = true;
+        }
+
+        StereoLayout layout = options.layout;
+        out.path = path;
+        out.layout = layout;
+        out.decodeScale = options.scale;
+        out.sourceEyeWidth = eyeWidth(image.cols, layout) * options.scale;
+
+        int maxTextureSize = settings.maxTextureSize;
+        if (maxTextureSize <= 0 || (image.cols <= maxTextureSize && image.rows <= maxTextureSize))
+        {
+            out.image = image;
+            return true;
+        }
+
+        TRACE_ZONE("Split");
+        cv::Rect roi_left, roi_right;
+        if (layout == SIDE_BY_SIDE)
+        {
+            roi_left  = cv::Rect(0, 0, image.cols / 2, image.rows);
+            roi_right = cv::Rect(image.cols / 2, 0, image.cols / 2, image.rows);
+        }
+        else
+        {
+            roi_left  = cv::Rect(0, 0, image.cols, image.rows / 2);
+            roi_right = cv::Rect(0, image.rows / 2, image.cols, image.rows / 2);
+        }
+        out.left = cv::Mat(image, roi_left);
+        out.right = cv::Mat(image, roi_right);
+        return true;
+    }
+};
+#endif
@@ -12,6 +12,21 @@
 
 #include "shader.h"
 #include "camera.h"
+#include "image_loader.h"
+#include "stereo_texture.h"
+#include "image_cache.h"
+#include "playlist.h"
+#include "eye_targets.h"
+#include "dynamic_resolution.h"
+#include "frame_reuse.h"
+#include "stereo_overlay.h"
+#include "hidden_area_mask.h"
+#include "gpu_timer.h"
+#include "quad_scissor.h"
+#include "uniform_buffer.h"
+#include "companion_mirror.h"
+#include "trace.h"
+#include "frame_timings.h"
 #include <iostream>
 #include "openvr.h"
 
@@ -19,14 +34,71 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+bool keyPressed(GLFWwindow *window, int key);
 
 // settings
 bool vr_enabled = true;
+StereoLayout stereoLayout = SIDE_BY_SIDE;
+MipFilter mipFilter = MIP_FILTER_BOX;
+bool srgbMips = false;
+// repack decoded pixels to RGB or RGBA on the loader thread, set with --swizzle rgb|rgba
+CpuSwizzle cpuSwizzle = SWIZZLE_NONE;
+size_t imageCacheBytes = 2048ull * 1024 * 1024;
+size_t textureCacheBytes = 0;
+// texture data uploaded per frame, larger images stream in over several frames
+size_t uploadBytesPerFrame = 4ull * 1024 * 1024;
+int prefetchRadius = 2;
+// decode at 1/2, 1/4 or 1/8 resolution when the quad is too small on screen to show more
+bool reducedDecode = true;
+std::string bakedCacheDir = "glvr_cache";
+bool bakeOnLoad = false;
+// keep linked shader programs in bakedCacheDir so later launches skip compiling them
+bool cacheProgramBinaries = true;
+// GL_MAX_TEXTURE_SIZE assumed by --bake, which runs without a GL context
+const int BAKE_MAX_TEXTURE_SIZE = 16384;
+// RENDER_SINGLE_PASS_MULTIVIEW falls back to RENDER_SINGLE_PASS_LAYERED without GL_OVR_multiview2
+StereoRenderMode stereoRenderMode = RENDER_SINGLE_PASS_LAYERED;
+// eye buffer size relative to the runtime's recommended render target size, --supersampling
+float supersampling = 1.0f;
+// render a smaller part of the eye buffers when the GPU can not keep up with the display
+bool dynamicResolution = true;
+// resubmit the previous eye buffers while neither the head, the quad nor the image moved
+bool reuseStaticFrames = true;
+// Let the compositor show the image as a side by side stereo overlay, no scene rendering at all.
+// Runs as an overlay application; split or top bottom images only reach the companion window.
+// Fixed for the run since VR_Init takes the application type, set with --overlay.
+bool overlayMode = false;
+// skip the eye buffer pixels the lenses hide, for both the clear and the quad; H toggles it,
+// --no-hidden-area-mask starts without
+bool useHiddenAreaMask = true;
+// render with poses predicted for our own photon time instead of those from WaitGetPoses;
+// P toggles it, --predict-poses starts with it
+bool predictPoses = false;
+// clear and draw only around the quad, the rest of the eye buffers keeps the clear color;
+// Q toggles it, --no-scissor starts without
+bool scissorToQuad = true;
+// companion window frames per second, 0 to redraw it only on M or a new image (--companion-hz)
+float companionRate = 30.0f;
+// write the CPU trace after this many frames, 0 to write it only on T
+int traceFrames = 0;
+const std::string TRACE_PATH = "trace.json";
+// the compositor's timings of the last FrameTimings::CAPACITY frames, written at exit
+const std::string FRAME_TIMINGS_PATH = "frame_timings.csv";
+// --headless: offscreen context, render headlessFrames frames once the image is up, report
+// throughput and quit; --dump writes the final eye buffers to headlessDumpDir
+bool headless = false;
+int headlessFrames = 500;
+std::string headlessDumpDir;
+// seconds a headless run waits for its image before measuring without one
+const double HEADLESS_LOAD_TIMEOUT = 30.0;
+
+const glm::vec4 CLEAR_COLOR(0.2f, 0.3f, 0.3f, 1.0f);
 
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 500;
-const unsigned int RENDER_WIDTH =  4000;
-const unsigned int RENDER_HEIGHT = 4000;
+// Eye buffer size, from the runtime once OpenVR is up; the fallback only feeds the companion window
+unsigned int renderWidth = 2048;
+unsigned int renderHeight = 2048;
 
 // camera
 
@@ -67,23 +139,25 @@ glm::vec3 cubePositions[] = {
         glm::vec3( 0.0f,  2.0f,  -4.0f),
 };
 
-GLuint makeQuadTexture(const cv::Mat& mat){
-    GLuint texture;
-    cv::Mat image = mat.clone();
-    cv::cvtColor(image, image, cv::COLOR_BGR2RGBA);
-    imageAspect = (float) image.rows / image.cols;
-
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.cols, image.rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+// Per frame uniforms of both eyes, std140 layout of the StereoFrame block every quad shader reads
+struct StereoFrameBlock {
+    glm::mat4 mvp[2];
+    glm::vec4 uvScaleBias[2];
+};
 
-    return texture;
+// Width in eye buffer pixels that the quad covers, 0 when it can not be projected (behind the eye)
+int quadFootprintPixels(const glm::mat4& mvp){
+    float minX = 1.0f, maxX = -1.0f;
+    for (float x : {-1.0f, 1.0f}) {
+        for (float y : {-1.0f, 1.0f}) {
+            glm::vec4 clip = mvp * glm::vec4(x, y, 1.0f, 1.0f);
+            if (clip.w <= 0.0f)
+                return 0;
+            minX = std::min(minX, clip.x / clip.w);
+            maxX = std::max(maxX, clip.x / clip.w);
+        }
+    }
+    return (int) std::ceil((maxX - minX) * 0.5f * renderWidth);
 }
 
 glm::mat4 convertSteamVRmatToGLM( const vr::HmdMatrix34_t &matPose ) {
@@ -121,23 +195,362 @@ glm::mat4 getHMDMatrixProjectionEye( vr::Hmd_Eye nEye ) {
     );
 }
 
+// Per eye projection and eye to head transform. Both only change with IPD, lens or display
+// settings, so they are read from the runtime once and then only when an event asks for it.
+// Without a runtime a 90 degree frustum per eye buffer and an average IPD stand in.
+struct EyeMatrices {
+    static constexpr float FALLBACK_IPD = 0.064f;
+
+    glm::mat4 projection[2] = {glm::mat4(1.0f), glm::mat4(1.0f)};
+    glm::mat4 eyeToHead[2] = {glm::mat4(1.0f), glm::mat4(1.0f)};
+
+    void refresh(){
+        if (!vr::VRSystem()) {
+            for (int eye = 0; eye < 2; eye++) {
+                projection[eye] = glm::perspective(glm::radians(90.0f), (float) renderWidth / renderHeight, 0.1f, 100.0f);
+                eyeToHead[eye] = glm::translate(glm::mat4(1.0f), glm::vec3((eye == 0 ? -0.5f : 0.5f) * FALLBACK_IPD, 0.0f, 0.0f));
+            }
+            return;
+        }
+        for (int eye = 0; eye < 2; eye++) {
+            projection[eye] = getHMDMatrixProjectionEye((vr::Hmd_Eye) eye);
+            eyeToHead[eye] = getHMDMatrixPoseEye((vr::Hmd_Eye) eye);
+        }
+    }
+};
+
+// Display timing of the HMD for pose prediction, refreshed with EyeMatrices
+struct DisplayTiming {
+    float frameSeconds = 1.0f / 90.0f;
+    float vsyncToPhotons = 0.0f;
+
+    void refresh(){
+        if (!vr::VRSystem())
+            return;
+        float frequency = vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+        if (frequency > 0.0f)
+            frameSeconds = 1.0f / frequency;
+        vsyncToPhotons = vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+    }
+
+    // from now until the frame being started lights up the display
+    float secondsToPhotons() const {
+        float sinceVsync = 0.0f;
+        uint64_t frameCounter = 0;
+        vr::VRSystem()->GetTimeSinceLastVsync(&sinceVsync, &frameCounter);
+        return frameSeconds - sinceVsync + vsyncToPhotons;
+    }
+};
+
+// Whether an event can change what EyeMatrices, the hidden area mesh or the display rate hold
+bool changesEyeSetup(const vr::VREvent_t& event){
+    switch (event.eventType) {
+        case vr::VREvent_IpdChanged:
+        case vr::VREvent_LensDistortionChanged:
+        case vr::VREvent_ChaperoneUniverseHasChanged:
+            return true;
+        case vr::VREvent_PropertyChanged:
+            return event.trackedDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd;
+        default:
+            return false;
+    }
+}
+
 std::string g_inputPath = "w.jpg";
+bool g_inputChanged = false;
+bool g_companionRequested = false;
+bool g_traceRequested = false;
+bool g_gpuCsvRequested = false;
+// a toggle changed which eye buffer pixels get cleared, the next frame starts over with a full clear
+bool g_fullClearRequested = false;
+ImageLoader g_imageLoader;
+Playlist g_playlist;
+
+// Directory listings of openInput run on their own thread, the render thread only picks up the
+// newest finished one in pollPlaylistScan
+struct PlaylistScan {
+    std::string path;
+    Playlist playlist;
+    bool opened = false;
+    bool missing = false;
+};
+std::unique_ptr<ThreadPool> g_playlistScanner;
+std::mutex g_playlistScanMutex;
+std::unique_ptr<PlaylistScan> g_playlistScan;
+
+// a directory, or an image whose directory becomes the playlist, once the listing is done
+void openInput(const std::string& path){
+    if (!g_playlistScanner)
+        g_playlistScanner.reset(new ThreadPool(1, "Playlist"));
+    g_playlistScanner->clear();
+    g_playlistScanner->submit([path] {
+        std::unique_ptr<PlaylistScan> scan(new PlaylistScan);
+        scan->path = path;
+        scan->opened = scan->playlist.open(path);
+        std::error_code error;
+        scan->missing = !scan->opened && !std::filesystem::exists(path, error);
+        std::lock_guard<std::mutex> lock(g_playlistScanMutex);
+        g_playlistScan = std::move(scan);
+    });
+}
+
+// takes over the playlist of a finished openInput and shows its current image
+void pollPlaylistScan(){
+    std::unique_ptr<PlaylistScan> scanned;
+    {
+        std::lock_guard<std::mutex> lock(g_playlistScanMutex);
+        scanned = std::move(g_playlistScan);
+    }
+    if (!scanned)
+        return;
+    PlaylistScan& scan = *scanned;
+    if (scan.missing) {
+        std::cout << "Could not open " << scan.path << ": no such file or directory" << std::endl;
+        return;
+    }
+    g_inputPath = scan.path;
+    if (scan.opened) {
+        g_playlist = std::move(scan.playlist);
+        g_inputPath = g_playlist.current();
+    }
+    g_inputChanged = true;
+}
+
+// Texture cache key of path, which unlike ImageLoader::cacheKey needs no file access: a cached
+// texture may be at any decode scale, a finer decode is fetched as usual when it falls short
+std::string textureCacheKey(const std::string& path, StereoLayout layout){
+    return path + '|' + std::to_string(layout);
+}
 
 void dropCallback(GLFWwindow *window, int count, const char** paths){
     if (count > 0)
-        g_inputPath = paths[0];
+        openInput(paths[0]);
+}
+
+void showCacheStats(const char* name, const CacheStats& stats){
+    ImGui::Text("%s: %zu hits, %zu misses, %zu evicted", name, stats.hits, stats.misses, stats.evictions);
+    ImGui::Text("  %zu entries, %zu / %zu MB", stats.entries, stats.bytes >> 20, stats.budget >> 20);
+}
+
+// min / avg / p99 ms of every pass over the profiler's history
+void showGpuProfile(const GpuProfiler& profiler){
+    ImGui::Text("%-16s %7s %7s %7s", "pass", "min", "avg", "p99");
+    for (size_t i = 0; i < profiler.passCount(); i++) {
+        GpuProfiler::Stats stats = profiler.stats((int) i);
+        ImGui::Text("%-16s %7.3f %7.3f %7.3f", profiler.name((int) i).c_str(), stats.min, stats.avg, stats.p99);
+    }
+}
+
+// Percentiles and misses over the collected frames, with GPU time and frame interval plotted
+// against the display's frame budget
+void showFrameTimings(const FrameTimings& timings, float frameMs){
+    FrameTimings::Summary summary = timings.summarize();
+    ImGui::Text("%d frames, %d reprojected (%.1f%%)", summary.frames, summary.reprojected, summary.reprojectionRatio * 100.0f);
+    ImGui::Text("%d dropped, %d mispresented", summary.dropped, summary.misPresented);
+    ImGui::Text("GPU p50 %.2f  p90 %.2f  p99 %.2f ms", summary.gpuP50, summary.gpuP90, summary.gpuP99);
+    ImGui::Text("Interval p50 %.2f  p99 %.2f ms", summary.intervalP50, summary.intervalP99);
+
+    std::vector<float> gpu = timings.series(&FrameTimings::Sample::preSubmitGpuMs);
+    std::vector<float> post = timings.series(&FrameTimings::Sample::postSubmitGpuMs);
+    for (size_t i = 0; i < gpu.size(); i++)
+        gpu[i] += post[i];
+    std::vector<float> interval = timings.series(&FrameTimings::Sample::clientIntervalMs);
+    ImGui::PlotLines("GPU ms", gpu.data(), (int) gpu.size(), 0, nullptr, 0.0f, frameMs * 1.5f, ImVec2(0, 60));
+    ImGui::PlotLines("Interval ms", interval.data(), (int) interval.size(), 0, nullptr, 0.0f, frameMs * 3.0f, ImVec2(0, 60));
 }
 
+// Frame count and wall time of a --headless run
+struct HeadlessRun {
+    bool measuring = false;
+    int frames = 0;
+    double startSeconds = 0.0;
 
+    void start(double now){
+        measuring = true;
+        frames = 0;
+        startSeconds = now;
+    }
+
+    void report(double now, const GpuProfiler& profiler) const {
+        double seconds = now - startSeconds;
+        std::cout << "Headless: " << frames << " frames in " << seconds * 1000.0 << " ms, " << frames / seconds << " fps, "
+                  << seconds * 1000.0 / frames << " ms per frame" << std::endl;
+        for (size_t i = 0; i < profiler.passCount(); i++) {
+            GpuProfiler::Stats stats = profiler.stats((int) i);
+            if (stats.frames > 0)
+                std::cout << "  " << profiler.name((int) i) << ": GPU avg " << stats.avg << " ms, p99 " << stats.p99 << " ms" << std::endl;
+        }
+    }
+};
+
+// Writes the rendered part of both eye buffers to directory as left.png and right.png
+bool dumpEyeTargets(const EyeTargets& eyes, GLsizei width, GLsizei height, const std::string& directory){
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    bool ok = true;
+    for (int eye = 0; eye < 2; eye++) {
+        eyes.attachForRead(eye);
+        cv::Mat image(height, width, CV_8UC3);
+        glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+        // GL rows run bottom up
+        cv::flip(image, image, 0);
+        std::string path = (std::filesystem::path(directory) / (eye == 0 ? "left.png" : "right.png")).string();
+        ok &= cv::imwrite(path, image);
+
+        // a single color means the quad never made it into the eye buffer
+        cv::Scalar mean, deviation;
+        cv::meanStdDev(image, mean, deviation);
+        if (deviation[0] == 0.0 && deviation[1] == 0.0 && deviation[2] == 0.0) {
+            std::cout << (eye == 0 ? "Left" : "Right") << " eye buffer is a single color" << std::endl;
+            ok = false;
+        }
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    return ok;
+}
+
+// Clears the bound eye target, with a mask only its visible part (see HiddenAreaMask::clear)
+void clearEyeTarget(HiddenAreaMask* mask, int eye){
+    if (mask) {
+        mask->clear(eye, CLEAR_COLOR);
+        return;
+    }
+    glClearColor(CLEAR_COLOR.r, CLEAR_COLOR.g, CLEAR_COLOR.b, CLEAR_COLOR.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Companion view of one eye's half of the quad texture, for when no eye buffers are rendered
+void showQuadTextureEye(const StereoTexture& stereo, int eye, ImVec2 size){
+    if (!stereo.valid())
+        return;
+    glm::vec4 scaleBias = stereo.uvScaleBias[eye];
+    ImVec2 uv0 = {scaleBias.z, scaleBias.w};
+    ImVec2 uv1 = {scaleBias.z + scaleBias.x, scaleBias.w + scaleBias.y};
+    ImGui::Image( (void*)(intptr_t) stereo.texture[eye], size, uv0, uv1);
+}
+
+ImageLoaderSettings makeLoaderSettings(int maxTextureSize){
+    ImageLoaderSettings settings;
+    settings.maxTextureSize = maxTextureSize;
+    settings.mipFilter = mipFilter;
+    settings.srgbMips = srgbMips;
+    settings.swizzle = cpuSwizzle;
+    settings.cacheBytes = imageCacheBytes;
+    settings.bakedCacheDir = bakedCacheDir;
+    settings.bakeOnLoad = bakeOnLoad;
+    return settings;
+}
 
-int main()
+// Options that change what the loader produces, and with it the baked files, so --bake takes
+// them too. Returns false when argv[i] is none of them.
+bool parseLoaderOption(int argc, char** argv, int& i){
+    std::string arg = argv[i];
+    if (arg == "--swizzle" && i + 1 < argc) {
+        std::string order = argv[++i];
+        cpuSwizzle = order == "rgba" ? SWIZZLE_RGBA : order == "rgb" ? SWIZZLE_RGB : SWIZZLE_NONE;
+        return true;
+    }
+    return false;
+}
+
+// glvr --bake [--swizzle rgb|rgba] <image or directory>...
+// Writes the baked texture of every image into bakedCacheDir, where the viewer maps them from
+int bakeImages(int count, char** args){
+    std::vector<std::string> inputs;
+    for (int i = 0; i < count; i++) {
+        if (!parseLoaderOption(count, args, i))
+            inputs.push_back(args[i]);
+    }
+    ImageLoader loader(makeLoaderSettings(BAKE_MAX_TEXTURE_SIZE));
+    int failed = 0;
+
+    for (const std::string& input : inputs) {
+        std::vector<std::string> files;
+        Playlist playlist;
+        if (std::filesystem::is_directory(input) && playlist.open(input)) {
+            for (size_t j = 0; j < playlist.size(); j++, playlist.next())
+                files.push_back(playlist.current());
+        } else {
+            files.push_back(input);
+        }
+
+        for (const std::string& file : files) {
+            auto start = std::chrono::steady_clock::now();
+            std::string bakedFile;
+            DecodeOptions options;
+            options.layout = stereoLayout;
+            bool ok = loader.bake(file, options, bakedFile);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (ok) {
+                std::cout << "Baked " << file << " -> " << bakedFile << " (" << ms << " ms)" << std::endl;
+            } else {
+                std::cout << "Failed to bake " << file << std::endl;
+                failed++;
+            }
+        }
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--bake")
+        return bakeImages(argc - 2, argv + 2);
+
+    // [--overlay] [--swizzle rgb|rgba] [--supersampling F] [--no-hidden-area-mask] [--no-scissor]
+    // [--predict-poses] [--companion-hz N] [--headless [--frames N] [--dump directory]] [image or directory]
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (parseLoaderOption(argc, argv, i))
+            continue;
+        if (arg == "--overlay")
+            overlayMode = true;
+        else if (arg == "--supersampling" && i + 1 < argc)
+            supersampling = std::max(0.1f, (float) atof(argv[++i]));
+        else if (arg == "--no-hidden-area-mask")
+            useHiddenAreaMask = false;
+        else if (arg == "--no-scissor")
+            scissorToQuad = false;
+        else if (arg == "--predict-poses")
+            predictPoses = true;
+        else if (arg == "--companion-hz" && i + 1 < argc)
+            companionRate = std::max(0.0f, (float) atof(argv[++i]));
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--frames" && i + 1 < argc)
+            headlessFrames = std::max(1, atoi(argv[++i]));
+        else if (arg == "--dump" && i + 1 < argc)
+            headlessDumpDir = argv[++i];
+        else
+            g_inputPath = arg;
+    }
+    openInput(g_inputPath);
+    trace::setThreadName("Main");
+
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+    // Headless runs need no display: GLFW's null platform with an OSMesa context renders
+    // offscreen, on llvmpipe when there is no GPU
+    if (headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (headless) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
 
     // glfw window creation
@@ -156,7 +569,8 @@ int main()
     glfwSwapInterval(0);
 
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -169,14 +583,13 @@ int main()
     // Initialize ImGui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
-    ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL( window, true );
     ImGui_ImplOpenGL3_Init( "#version 330" );
 
     // Initialize OpenVR
     if (vr::VR_IsHmdPresent() && vr_enabled) {
         auto VRError = vr::VRInitError_None;
-        auto VRSystem = vr::VR_Init(&VRError, vr::VRApplication_Scene);
+        auto VRSystem = vr::VR_Init(&VRError, overlayMode ? vr::VRApplication_Overlay : vr::VRApplication_Scene);
 
         if (VRError != vr::VRInitError_None){
             std::cout << "OpenVR initialization failed: " << vr::VR_GetVRInitErrorAsEnglishDescription(VRError) << std::endl;
@@ -186,39 +599,37 @@ int main()
     }else{
         std::cout << "HMD not found" << std::endl;
     }
+    // without a runtime everything below takes the desktop path
+    vr_enabled = vr_enabled && vr::VRSystem();
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    DynamicResolution resolution;
+    if (vr::VRSystem()) {
+        uint32_t recommendedWidth = 0, recommendedHeight = 0;
+        vr::VRSystem()->GetRecommendedRenderTargetSize(&recommendedWidth, &recommendedHeight);
+        renderWidth = (unsigned int) std::min<float>(recommendedWidth * supersampling, maxTextureSize);
+        renderHeight = (unsigned int) std::min<float>(recommendedHeight * supersampling, maxTextureSize);
+        resolution.setDisplayFrequency(vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float));
+    }
+    std::cout << "Eye buffers " << renderWidth << "x" << renderHeight << std::endl;
 
+    // In overlay mode the compositor draws the image and no eye buffers are needed
+    OpenVROverlayBackend overlayBackend;
+    StereoOverlay stereoOverlay(overlayBackend);
+    bool overlayActive = overlayMode && vr::VROverlay() && stereoOverlay.open();
+    GLuint unsupportedOverlayTexture = 0;
 
+    // Eye buffers, a texture per eye or both eyes as layers of one array texture
+    EyeTargets eyeTargets;
+    if (!overlayActive)
+        eyeTargets.create(stereoRenderMode, renderWidth, renderHeight);
 
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, RENDER_WIDTH, RENDER_HEIGHT);
-
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
-
-    GLuint rightEyeTexture;
-    glGenTextures(1, &rightEyeTexture);
-    glBindTexture(GL_TEXTURE_2D, rightEyeTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, RENDER_WIDTH, RENDER_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    GLuint leftEyeTexture;
-    glGenTextures(1, &leftEyeTexture);
-    glBindTexture(GL_TEXTURE_2D, leftEyeTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, RENDER_WIDTH, RENDER_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
     unsigned int VBO, VAO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -236,164 +647,594 @@ int main()
     glEnableVertexAttribArray(1);
 
 
-    // Quad texture
-    while ( g_inputPath.empty() ){
-        glfwPollEvents();
-    }
+    // Quad texture, decoded in the background and swapped in once ready
+    g_imageLoader.start(makeLoaderSettings(maxTextureSize));
+
+    StereoTexture quadTexture;
+    std::string quadTextureKey;
+    // the next quad texture while it streams in, swapped in once complete
+    StereoTextureUpload textureUpload;
+
+    // Recently shown textures stay resident so switching back skips the upload too
+    LruCache<StereoTexture> textureCache(textureCacheBytes, deleteStereoTexture);
 
-    cv::Mat input_image = cv::imread(g_inputPath);
+    // eye buffer pixels the quad spans, drives the decode scale; 0 until known
+    int quadFootprint = 0;
+    int requestedScale = 1;
 
-    cv::Rect roi_left(0, 0, input_image.cols / 2, input_image.rows);
-    cv::Rect roi_right(input_image.cols / 2, 0, input_image.cols / 2, input_image.rows);
-    cv::Mat left_half(input_image, roi_left);
-    cv::Mat right_half(input_image, roi_right);
+    // load-to-first-frame timing of the most recently swapped in image
+    bool reportFirstFrame = false;
+    DecodedImage loadedImage;
+    double uploadMs = 0.0;
+    int uploadFrames = 0;
 
-    GLuint leftColor = makeQuadTexture(left_half);
-    GLuint rightColor = makeQuadTexture(right_half);
 
+    // Both eyes' matrices in one uniform block, uploaded once per frame
+    UniformBuffer<StereoFrameBlock> stereoFrame(0);
+    stereoFrame.create();
+
+    ProgramBinaryCache programCache((std::filesystem::path(bakedCacheDir) / "programs").string());
+    if (cacheProgramBinaries)
+        Shader::binaryCache = &programCache;
 
     Shader ourShader("../camera.vs", "../camera.fs");
     ourShader.use();
+    ourShader.bindUniformBlock("StereoFrame", stereoFrame.bindingPoint());
+    GLint eyeLocation = ourShader.location("eye");
 //    ourShader.setInt("leftColor", 0);
 
-    vr::TrackedDevicePose_t vrTrackedDevicePose[vr::k_unMaxTrackedDeviceCount];
-
+    // Single pass stereo: both eyes in one draw
+    bool multiview = eyeTargets.mode == RENDER_SINGLE_PASS_MULTIVIEW;
+    Shader stereoShader(multiview ? "../stereo_multiview.vs" : "../stereo.vs", "../stereo.fs", multiview ? nullptr : "../stereo.gs");
+    stereoShader.use();
+    stereoShader.setInt("eyeTexture0", 0);
+    stereoShader.setInt("eyeTexture1", 1);
+    stereoShader.bindUniformBlock("StereoFrame", stereoFrame.bindingPoint());
+
+    HiddenAreaMask hiddenAreaMask;
+    if (!overlayActive) {
+        hiddenAreaMask.create(multiview);
+        hiddenAreaMask.load();
+    }
+    if (cacheProgramBinaries)
+        programCache.report();
+
+    // GPU time of each pass, to see where a frame goes and weigh render path options
+    GpuProfiler gpuProfiler;
+    int clearPass = gpuProfiler.pass("Eye clear");
+    int drawPass = gpuProfiler.pass("Quad draw");
+    int uploadPass = gpuProfiler.pass("Texture upload");
+    int mirrorPass = gpuProfiler.pass("Mirror blit");
+    int companionPass = gpuProfiler.pass("Companion");
+    std::string gpuProfilePath = "gpu_profile.csv";
+    QuadScissor quadScissor;
+
+    // without a runtime filling these in the head stays level with the quad, looking at it
+    vr::TrackedDevicePose_t vrTrackedDevicePose[vr::k_unMaxTrackedDeviceCount] = {};
+    vrTrackedDevicePose[0].mDeviceToAbsoluteTracking = {{{1, 0, 0, 0}, {0, 1, 0, cubePositions[0].y}, {0, 0, 1, 0}}};
+
+    EyeMatrices eyeMatrices;
+    eyeMatrices.refresh();
+    DisplayTiming displayTiming;
+    displayTiming.refresh();
+    FrameTimings frameTimings;
+
+    // how old the render pose is when the frame is submitted, averaged
+    float poseAgeMs = 0.0f;
+    bool sceneVR = vr_enabled && !overlayActive && vr::VRCompositor();
+
+    // Downsampled eye buffers for the companion window, only refreshed when it is redrawn
+    CompanionMirror companionMirror;
+    companionMirror.rate = companionRate;
+    if (!overlayActive)
+        companionMirror.create(SCR_WIDTH / 2, SCR_HEIGHT);
+    bool mirrorStale = false;
+
+    // Every headless frame renders, the throughput would mean nothing with static frames reused
+    HeadlessRun headlessRun;
+    // non-zero when a headless run's eye buffers could not be dumped or show nothing
+    int exitCode = 0;
+    if (headless)
+        reuseStaticFrames = false;
+
+    // Pose the eye buffers were last rendered at, submitted along with them
+    FrameReuse frameReuse;
+    vr::HmdMatrix34_t renderedPose = {};
+    int reusedFrames = 0;
+
+    long frameCount = 0;
+    // serialises the last trace capture, joined before the next one and at exit so none is lost
+    std::thread traceExport;
     while (!glfwWindowShouldClose(window)) {
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        TRACE_ZONE("Frame");
+        gpuProfiler.beginFrame();
 
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, RENDER_WIDTH, RENDER_HEIGHT);
+        // Only the bottom left viewportWidth x viewportHeight of the eye buffers gets rendered
+        float resolutionScale = dynamicResolution ? resolution.scale() : 1.0f;
+        GLsizei viewportWidth = std::max<GLsizei>(1, (GLsizei) (renderWidth * resolutionScale));
+        GLsizei viewportHeight = std::max<GLsizei>(1, (GLsizei) (renderHeight * resolutionScale));
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput(window);
+        if (g_fullClearRequested) {
+            frameReuse.invalidate();
+            quadScissor.invalidate();
+            g_fullClearRequested = false;
+        }
+        if (g_companionRequested) {
+            companionMirror.request();
+            g_companionRequested = false;
+        }
+        // everything since the last trace, the frame that just started is in the next one
+        if (g_traceRequested || ++frameCount == traceFrames) {
+            if (traceExport.joinable())
+                traceExport.join();
+            traceExport = std::thread([capture = trace::capture()] {
+                int zones = trace::write(TRACE_PATH, capture);
+                if (zones < 0)
+                    std::cout << "Could not write " << TRACE_PATH << std::endl;
+                else
+                    std::cout << "Trace of " << zones << " zones written to " << TRACE_PATH << std::endl;
+            });
+            g_traceRequested = false;
+        }
+        if (g_gpuCsvRequested) {
+            std::cout << (gpuProfiler.writeCsv(gpuProfilePath) ? "GPU profile written to " : "Could not write ") << gpuProfilePath << std::endl;
+            g_gpuCsvRequested = false;
+        }
 
-        vr::HmdMatrix44_t steamProjectionMatrix{};
-        vr::HmdMatrix34_t steamEyeDisparityMatrix = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
-        glm::mat4 eyeDisparity;
-        glm::mat4 projection;
-//        vr::HmdMatrix34_t hmdPose = vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::k_unTrackedDeviceIndex_Hmd, vr::k_ulInvalidInputValue)->mDeviceToAbsoluteTracking;
+        // Drain the runtime's events before anything of this frame depends on them
+        if(vr_enabled && vr::VRSystem()){
+            vr::VREvent_t event;
+            bool eyeSetupChanged = false;
+            while (vr::VRSystem()->PollNextEvent(&event, sizeof(event))) {
+                if (event.eventType == vr::VREvent_Quit) {
+                    vr::VRSystem()->AcknowledgeQuit_Exiting();
+                    glfwSetWindowShouldClose(window, true);
+                }
+                eyeSetupChanged |= changesEyeSetup(event);
+            }
+            if (eyeSetupChanged) {
+                eyeMatrices.refresh();
+                displayTiming.refresh();
+                hiddenAreaMask.load();
+                resolution.setDisplayFrequency(vr::VRSystem()->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float));
+                frameReuse.invalidate();
+                quadScissor.invalidate();
+            }
+        }
 
+        // Poses first: this frame renders with the poses predicted for its own photons
+        if(overlayActive){
+            // Overlay applications get no WaitGetPoses, pace on the compositor's frames instead
+            // and read the head pose for the decode resolution directly
+            {
+                TRACE_ZONE("WaitFrameSync");
+                vr::VROverlay()->WaitFrameSync(100);
+            }
+            vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), 0.0f, vrTrackedDevicePose, vr::k_unMaxTrackedDeviceCount);
+        } else if(sceneVR){
+            {
+                TRACE_ZONE("WaitGetPoses");
+                vr::VRCompositor()->WaitGetPoses(vrTrackedDevicePose, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
+            }
+            if(predictPoses)
+                vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), displayTiming.secondsToPhotons(),
+                                                                vrTrackedDevicePose, vr::k_unMaxTrackedDeviceCount);
+        }
+        auto poseTime = std::chrono::steady_clock::now();
 
-        for (Camera *cam : Cameras.array) {
+//        vr::HmdMatrix34_t hmdPose = vr::VRSystem()->GetDeviceToAbsoluteTrackingPose(vr::k_unTrackedDeviceIndex_Hmd, vr::k_ulInvalidInputValue)->mDeviceToAbsoluteTracking;
 
-            if(cam == &Cameras.left){
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, leftEyeTexture, 0);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                glBindTexture(GL_TEXTURE_2D, leftColor);
-                if(vr_enabled){
-                    projection = getHMDMatrixProjectionEye(vr::Eye_Left);
-                    eyeDisparity = getHMDMatrixPoseEye(vr::Eye_Left);
-                }
-            }
 
-            if(cam == &Cameras.right){
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rightEyeTexture, 0);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                glBindTexture(GL_TEXTURE_2D, rightColor);
+        FrameState frameState;
+        frameState.headPose = convertSteamVRmatToGLM( vrTrackedDevicePose[0].mDeviceToAbsoluteTracking );
+        frameState.viewportWidth = viewportWidth;
+        frameState.viewportHeight = viewportHeight;
 
-                if(vr_enabled){
-                    projection = getHMDMatrixProjectionEye(vr::Eye_Right);
-                    eyeDisparity = getHMDMatrixPoseEye(vr::Eye_Right);
-                }
-            }
+        glm::mat4 hmdPose = glm::inverse(frameState.headPose);
 
-            glm::mat4 hmdPose = convertSteamVRmatToGLM( vrTrackedDevicePose[0].mDeviceToAbsoluteTracking );
-            vrTrackedDevicePose[0].eTrackingResult;
-            hmdPose = glm::inverse(hmdPose);
+        // Moving the quad and applying aspect ratio
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, cubePositions[0]);
+        model = glm::scale(model, glm::vec3(1.0f, imageAspect, 1.0f) );
 
+        // Eye index matches vr::Eye_Left / vr::Eye_Right
+        glm::mat4 eyeMvp[2];
+        for (int eye = 0; eye < 2; eye++) {
+            glm::mat4 projection = eyeMatrices.projection[eye];
+            glm::mat4 eyeDisparity = eyeMatrices.eyeToHead[eye];
 
-            // Moving the quad and applying aspect ratio
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[0]);
-            model = glm::scale(model, glm::vec3(1.0f, imageAspect, 1.0f) );
+            eyeMvp[eye] = projection * hmdPose * eyeDisparity  * model;
 
-            glm::mat4 mvp = projection * hmdPose * eyeDisparity  * model;
+            frameState.eyeProjection[eye] = projection * eyeDisparity;
+            frameState.model = model;
+            frameState.texture[eye] = quadTexture.texture[eye];
+            frameState.uvScaleBias[eye] = quadTexture.uvScaleBias[eye];
 
-            ourShader.use();
-            ourShader.setMat4("mvp", mvp);
+            if(vr_enabled){
+                int footprint = quadFootprintPixels(eyeMvp[eye]);
+                if(footprint > 0)
+                    quadFootprint = eye == 0 ? footprint : std::max(quadFootprint, footprint);
+            }
+        }
 
-            // Render quad
-            glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        // A still image seen from a still head renders exactly what the eye buffers already hold
+        bool reuseFrame = reuseStaticFrames && frameReuse.canReuse(frameState);
+        if(overlayActive){
+            // the compositor draws the overlay, the eye buffers are never touched
+        } else if(reuseFrame){
+            reusedFrames++;
+        } else {
+            eyeTargets.bind();
+            glViewport(0, 0, viewportWidth, viewportHeight);
+            HiddenAreaMask* mask = useHiddenAreaMask && !hiddenAreaMask.empty() ? &hiddenAreaMask : nullptr;
+
+            PixelRect quadRect[2];
+            for (int eye = 0; eye < 2; eye++)
+                quadRect[eye] = projectQuadRect(eyeMvp[eye], viewportWidth, viewportHeight);
+            if(scissorToQuad)
+                glEnable(GL_SCISSOR_TEST);
+
+            StereoFrameBlock frame;
+            for (int eye = 0; eye < 2; eye++) {
+                frame.mvp[eye] = eyeMvp[eye];
+                frame.uvScaleBias[eye] = quadTexture.uvScaleBias[eye];
+            }
+            stereoFrame.update(frame);
+
+            // Render quad, nothing to show until the first image finishes loading
+            if(eyeTargets.singlePass()){
+                // Both eyes in one clear and one draw, the scissor is shared by the layers
+                setScissor(quadScissor.update(0, quadRect[0].united(quadRect[1]), viewportWidth, viewportHeight));
+                gpuProfiler.begin(clearPass);
+                clearEyeTarget(mask, -1);
+                gpuProfiler.end(clearPass);
+
+                stereoShader.use();
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, quadTexture.texture[1]);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, quadTexture.texture[0]);
+
+                gpuProfiler.begin(drawPass);
+                if(quadTexture.valid()){
+                    glBindVertexArray(VAO);
+                    if(multiview)
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                    else
+                        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, 2);
+                }
+                gpuProfiler.end(drawPass);
+                if(mask)
+                    mask->end();
+                glDisable(GL_SCISSOR_TEST);
+            } else {
+                for (int eye = 0; eye < 2; eye++) {
+                    eyeTargets.bind(eye);
+                    setScissor(quadScissor.update(eye, quadRect[eye], viewportWidth, viewportHeight));
+                    gpuProfiler.begin(clearPass);
+                    clearEyeTarget(mask, eye);
+                    gpuProfiler.end(clearPass);
+                    glBindTexture(GL_TEXTURE_2D, quadTexture.texture[eye]);
+                    // the mask clear runs its own program, so this one is bound per eye
+                    ourShader.use();
+                    ourShader.setInt(eyeLocation, eye);
+
+                    gpuProfiler.begin(drawPass);
+                    if(quadTexture.valid()){
+                        glBindVertexArray(VAO);
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                    }
+                    gpuProfiler.end(drawPass);
+                }
+                if(mask)
+                    mask->end();
+                glDisable(GL_SCISSOR_TEST);
+            }
 
+            frameReuse.rendered(frameState);
+            mirrorStale = true;
+            renderedPose = vrTrackedDevicePose[0].mDeviceToAbsoluteTracking;
         }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // Pass textures to OpenVR
-        if(vr_enabled){
-
-            vr::VRCompositor()->WaitGetPoses(vrTrackedDevicePose, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
+        if(sceneVR){
+            // Bounds run top down while GL textures are stored bottom up, so the rendered
+            // viewport covers the bottom of the v range
+            float uMax = (float) viewportWidth / renderWidth;
+            float vMin = 1.0f - (float) viewportHeight / renderHeight;
+            vr::VRTextureBounds_t bounds = {0.0f, vMin, uMax, 1.0f};
 
-            vr::Texture_t leftEye = {(void *) (uintptr_t) leftEyeTexture, vr::TextureType_OpenGL, vr::ColorSpace_Gamma};
-            vr::Texture_t rightEye = {(void *) (uintptr_t) rightEyeTexture, vr::TextureType_OpenGL, vr::ColorSpace_Gamma};
+            // Always tell the compositor which pose the buffers belong to, a reused frame is
+            // then reprojected to the current head pose
+            vr::EVRSubmitFlags submitFlags = (vr::EVRSubmitFlags) (eyeTargets.submitFlags() | vr::Submit_TextureWithPose);
 
             int error = 0;
-            error |= vr::VRCompositor()->Submit(vr::Eye_Left, &leftEye);
-            error |= vr::VRCompositor()->Submit(vr::Eye_Right, &rightEye);
+            for (int eye = 0; eye < 2; eye++) {
+                TRACE_ZONE("Submit");
+                vr::VRTextureWithPose_t eyeTexture;
+                eyeTexture.handle = (void *) (uintptr_t) eyeTargets.submitTexture(eye);
+                eyeTexture.eType = vr::TextureType_OpenGL;
+                eyeTexture.eColorSpace = vr::ColorSpace_Gamma;
+                eyeTexture.mDeviceToAbsoluteTracking = renderedPose;
+                error |= vr::VRCompositor()->Submit((vr::Hmd_Eye) eye, &eyeTexture, &bounds, submitFlags);
+            }
 
             if(error != vr::VRCompositorError_None)
                 std::cout << "Submit error: " << error;
 
-        }
+            // the frame is complete, let the compositor start on it before we do anything else
+            vr::VRCompositor()->PostPresentHandoff();
 
+            float age = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - poseTime).count();
+            poseAgeMs = poseAgeMs > 0.0f ? poseAgeMs * 0.95f + age * 0.05f : age;
 
-        // Render ImGui
-        int flags = ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBringToFrontOnFocus;
-        ImVec2 size = ImVec2(SCR_WIDTH / 2, SCR_HEIGHT);
+            // Every frame the compositor finished since the last call, the GPU time of the
+            // newest drives the next frame's resolution
+            if (frameTimings.collect(vr::VRCompositor()) > 0 && dynamicResolution)
+                resolution.update(frameTimings.latest().gpuMs());
+        }
 
-        // Flip verically
-        ImVec2 uv0 = {0, 1};
-        ImVec2 uv1 = {1, 0};
+        if (reportFirstFrame) {
+            double totalMs = std::chrono::duration<double, std::milli>(DecodedImage::Clock::now() - loadedImage.requested).count();
+            std::cout << "Loaded " << loadedImage.path << ": " << totalMs << " ms to first frame (decode "
+                      << loadedImage.decodeMs << " ms, mips " << loadedImage.mipMs << " ms, upload " << uploadMs << " ms over "
+                      << uploadFrames << " frames)" << std::endl;
+            reportFirstFrame = false;
+        }
 
-        ImGui::SetNextWindowPos(ImVec2(0,0));
-        ImGui::SetNextWindowSize( size );
-        ImGui::Begin("LOL", nullptr, flags);
-            ImGui::Image( (void*)(intptr_t) leftEyeTexture, size, uv0, uv1);
-        ImGui::End();
+        // Stream in a freshly decoded image after the frame has been handed to the compositor,
+        // a budgeted slice per frame, so the upload never delays a submit or the next poses
+        int targetEyeWidth = reducedDecode ? quadFootprint : 0;
+        pollPlaylistScan();
+        if (g_inputChanged && !g_inputPath.empty()) {
+            g_inputChanged = false;
+            // the decode scale and the loader's cache key need the file, they are resolved on
+            // the loader thread
+            std::string key = textureCacheKey(g_inputPath, stereoLayout);
+            StereoTexture cached;
+            // an upload of anything else is stale now
+            bool uploading = textureUpload.active() && key == textureCacheKey(textureUpload.source().path, textureUpload.source().layout);
+            if (!uploading)
+                textureUpload.cancel();
+            if (key == quadTextureKey || uploading) {
+                // already on screen or on its way there, just drop whatever was still loading
+                g_imageLoader.cancel();
+            } else if (textureCache.take(key, cached)) {
+                g_imageLoader.cancel();
+                if (!textureCache.put(quadTextureKey, quadTexture, quadTexture.bytes))
+                    deleteStereoTexture(quadTexture);
+                quadTexture = cached;
+                quadTextureKey = key;
+                imageAspect = quadTexture.aspect;
+                requestedScale = quadTexture.decodeScale;
+            } else {
+                // no finer decode is asked for until this one has landed
+                requestedScale = 0;
+                g_imageLoader.request(g_inputPath, stereoLayout, targetEyeWidth);
+            }
+            g_imageLoader.prefetch(g_playlist.neighbours(prefetchRadius), stereoLayout, targetEyeWidth);
+        } else if (reducedDecode && quadTexture.decodeScale > 1 && !g_imageLoader.busy() && !textureUpload.active()) {
+            // Zoomed in past what the current decode resolves, fetch a finer one. Never the
+            // other way around, zooming out keeps the sharper texture.
+            int scale = ImageLoader::decodeScaleFor(quadTexture.sourceEyeWidth, targetEyeWidth);
+            if (scale < quadTexture.decodeScale && scale < requestedScale) {
+                requestedScale = scale;
+                DecodeOptions options;
+                options.layout = stereoLayout;
+                options.scale = scale;
+                g_imageLoader.request(g_inputPath, options);
+            }
+        }
 
-        ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2,0));
-        ImGui::SetNextWindowSize( size );
-        ImGui::Begin("LOLXD", nullptr, flags);
-            ImGui::Image( (void*)(intptr_t) rightEyeTexture, size, uv0, uv1 );
-        ImGui::End();
+        DecodedImage decoded;
+        if (g_imageLoader.poll(decoded))
+            textureUpload.begin(decoded);
+        if (textureUpload.active()) {
+            gpuProfiler.begin(uploadPass);
+            bool uploaded = textureUpload.step(uploadBytesPerFrame);
+            gpuProfiler.end(uploadPass);
+
+            if (uploaded) {
+                const DecodedImage& source = textureUpload.source();
+                uploadMs = std::chrono::duration<double, std::milli>(DecodedImage::Clock::now() - textureUpload.started).count();
+                uploadFrames = textureUpload.frames;
+                loadedImage.path = source.path;
+                loadedImage.requested = source.requested;
+                loadedImage.decodeMs = source.decodeMs;
+                loadedImage.mipMs = source.mipMs;
+                std::string key = textureCacheKey(source.path, source.layout);
+
+                // a finer decode of the same image replaces the texture, nothing to keep
+                if (key == quadTextureKey || !textureCache.put(quadTextureKey, quadTexture, quadTexture.bytes))
+                    deleteStereoTexture(quadTexture);
+                quadTexture = textureUpload.take();
+                quadTextureKey = key;
+                imageAspect = quadTexture.aspect;
+                requestedScale = quadTexture.decodeScale;
+
+                reportFirstFrame = true;
+                // shown from the next frame on, which is when the eye buffers have it
+                g_companionRequested = true;
+            }
+        }
 
+        if (overlayActive && !stereoOverlay.present(quadTexture, frameState.model) &&
+            quadTexture.valid() && quadTexture.texture[0] != unsupportedOverlayTexture) {
+            std::cout << "Overlay mode shows whole side by side images only, " << g_inputPath << " is not shown in the headset" << std::endl;
+            unsupportedOverlayTexture = quadTexture.texture[0];
+        }
 
-        std::ostringstream out;
-        out.precision(2);
 
-        std::cout << glm::to_string(eyeDisparity) << std::endl;
+        // Companion window, at its own rate and not at all while minimised
+        double now = glfwGetTime();
+        if (!headless && !glfwGetWindowAttrib(window, GLFW_ICONIFIED) && companionMirror.due(now)) {
+            if (mirrorStale && companionMirror.texture[0]) {
+                gpuProfiler.begin(mirrorPass);
+                companionMirror.update(eyeTargets, viewportWidth, viewportHeight);
+                gpuProfiler.end(mirrorPass);
+                mirrorStale = false;
+            }
 
-        ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10,0));
-        ImGui::SetNextWindowSize( ImVec2(200, 100) );
-        ImGui::Begin("LOLXDE");
-            ImGui::Text("%s", glm::to_string(eyeDisparity).c_str() );
-        ImGui::End();
+            int64_t imguiStart = trace::nowNs();
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+
+            // Render ImGui
+            int flags = ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBringToFrontOnFocus;
+            ImVec2 size = ImVec2(SCR_WIDTH / 2, SCR_HEIGHT);
+
+            // Flip verically, the mirror holds just the rendered part of the eye buffers
+            ImVec2 uv0 = {0, 1};
+            ImVec2 uv1 = {1, 0};
+
+            ImGui::SetNextWindowPos(ImVec2(0,0));
+            ImGui::SetNextWindowSize( size );
+            ImGui::Begin("LOL", nullptr, flags);
+                if (overlayActive)
+                    showQuadTextureEye(quadTexture, 0, size);
+                else
+                    ImGui::Image( (void*)(intptr_t) companionMirror.texture[0], size, uv0, uv1);
+            ImGui::End();
+
+            ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2,0));
+            ImGui::SetNextWindowSize( size );
+            ImGui::Begin("LOLXD", nullptr, flags);
+                if (overlayActive)
+                    showQuadTextureEye(quadTexture, 1, size);
+                else
+                    ImGui::Image( (void*)(intptr_t) companionMirror.texture[1], size, uv0, uv1 );
+            ImGui::End();
+
+
+            ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10,0));
+            ImGui::SetNextWindowSize( ImVec2(200, 100) );
+            ImGui::Begin("LOLXDE");
+                ImGui::Text("%s", glm::to_string(eyeMatrices.eyeToHead[1]).c_str() );
+            ImGui::End();
+
+            ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10, 100), ImGuiCond_FirstUseEver);
+            ImGui::Begin("Cache");
+                showCacheStats("Decoded", g_imageLoader.cacheStats());
+                showCacheStats("Textures", textureCache.getStats());
+            ImGui::End();
+
+            ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10, 200), ImGuiCond_FirstUseEver);
+            ImGui::Begin("Resolution");
+                ImGui::Text("Eye buffers %ux%u, rendering %dx%d", renderWidth, renderHeight, viewportWidth, viewportHeight);
+                ImGui::Text("GPU %.2f ms, budget %.2f ms", resolution.gpuMs(), resolution.budgetMs());
+                if (ImGui::Checkbox("Dynamic resolution", &dynamicResolution) && !dynamicResolution)
+                    resolution.reset();
+                ImGui::Checkbox("Reuse static frames", &reuseStaticFrames);
+                // either toggle can leave stale pixels outside the quad, start over with a full clear
+                if (ImGui::Checkbox("Hidden area mask", &useHiddenAreaMask) | ImGui::Checkbox("Scissor to quad", &scissorToQuad)) {
+                    frameReuse.invalidate();
+                    quadScissor.invalidate();
+                }
+                ImGui::Text("Eye render GPU %.3f ms", gpuProfiler.stats(clearPass).avg + gpuProfiler.stats(drawPass).avg);
+                ImGui::Text("Reused %d frames", reusedFrames);
+                ImGui::Checkbox("Predict poses", &predictPoses);
+                ImGui::Text("Pose to submit %.2f ms", poseAgeMs);
+                ImGui::SliderFloat("Companion Hz", &companionMirror.rate, 0.0f, 90.0f, "%.0f");
+            ImGui::End();
+
+            ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10, 300), ImGuiCond_FirstUseEver);
+            ImGui::Begin("GPU");
+                showGpuProfile(gpuProfiler);
+                if (ImGui::Button("Save CSV"))
+                    g_gpuCsvRequested = true;
+            ImGui::End();
+
+            if (sceneVR) {
+                ImGui::SetNextWindowPos(ImVec2(SCR_WIDTH / 2 - 10, 400), ImGuiCond_FirstUseEver);
+                ImGui::Begin("Compositor");
+                    showFrameTimings(frameTimings, displayTiming.frameSeconds * 1000.0f);
+                ImGui::End();
+            }
 
+            ImGui::Render();
+            trace::record("ImGui build", imguiStart, trace::nowNs());
+            gpuProfiler.begin(companionPass);
+            ImGui_ImplOpenGL3_RenderDrawData( ImGui::GetDrawData() );
+            gpuProfiler.end(companionPass);
+            {
+                TRACE_ZONE("Swap");
+                glfwSwapBuffers(window);
+            }
+            companionMirror.presented(now);
+        }
 
+        // --headless: every frame waits for the GPU, so the count measures the whole pipeline
+        if (headless) {
+            glFinish();
+            if (headlessRun.measuring) {
+                headlessRun.frames++;
+            } else if (quadTexture.valid() || glfwGetTime() > HEADLESS_LOAD_TIMEOUT) {
+                if (!quadTexture.valid())
+                    std::cout << "Headless: no image after " << HEADLESS_LOAD_TIMEOUT << " s, measuring without one" << std::endl;
+                headlessRun.start(glfwGetTime());
+            }
+        }
+        gpuProfiler.endFrame();
+        if (headless && headlessRun.frames >= headlessFrames) {
+            headlessRun.report(glfwGetTime(), gpuProfiler);
+            if (!headlessDumpDir.empty() && !overlayActive) {
+                if (dumpEyeTargets(eyeTargets, viewportWidth, viewportHeight, headlessDumpDir)) {
+                    std::cout << "Eye buffers written to " << headlessDumpDir << std::endl;
+                } else {
+                    std::cout << "Could not write good eye buffers to " << headlessDumpDir << std::endl;
+                    exitCode = 1;
+                }
+                gpuProfiler.writeCsv((std::filesystem::path(headlessDumpDir) / gpuProfilePath).string());
+            }
+            glfwSetWindowShouldClose(window, true);
+        }
 
-        // End of frame
-        glfwPollEvents();
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData( ImGui::GetDrawData() );
-        glfwSwapBuffers(window);
+        // End of frame. Without the compositor pacing the loop, sleep until the window is due
+        // or input arrives
+        double wait = sceneVR || overlayActive || headless ? 0.0 : companionMirror.secondsUntilDue(glfwGetTime(), 0.1);
+        if (wait > 0.0)
+            glfwWaitEventsTimeout(wait);
+        else
+            glfwPollEvents();
     }
 
     // Cleanup
+    if (!frameTimings.empty()) {
+        FrameTimings::Summary summary = frameTimings.summarize();
+        std::cout << "Compositor, last " << summary.frames << " frames: GPU p50 " << summary.gpuP50 << " / p99 " << summary.gpuP99
+                  << " ms, " << summary.reprojectionRatio * 100.0f << "% reprojected, " << summary.dropped << " dropped, "
+                  << summary.misPresented << " mispresented" << std::endl;
+        if (!frameTimings.writeCsv(FRAME_TIMINGS_PATH))
+            std::cout << "Could not write " << FRAME_TIMINGS_PATH << std::endl;
+    }
+    if (traceExport.joinable())
+        traceExport.join();
+    g_playlistScanner.reset();
+    g_imageLoader.stop();
+    stereoOverlay.close();
+    textureUpload.cancel();
+    deleteStereoTexture(quadTexture);
+    textureCache.clear();
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    companionMirror.destroy();
+    hiddenAreaMask.destroy();
+    gpuProfiler.destroy();
+    stereoFrame.destroy();
+    Shader::binaryCache = nullptr;
+    eyeTargets.destroy();
 
     ImGui_ImplGlfw_Shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui::DestroyContext();
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -434,6 +1275,63 @@ void processInput(GLFWwindow *window)
     if(zoomSpeed){
         cubePositions[0][2] += zoomSpeed * deltaTime;
     }
+
+    // Playlist navigation, one step per key press
+    if (keyPressed(window, GLFW_KEY_RIGHT) && !g_playlist.empty()){
+        g_playlist.next();
+        g_inputPath = g_playlist.current();
+        g_inputChanged = true;
+    }
+    if (keyPressed(window, GLFW_KEY_LEFT) && !g_playlist.empty()){
+        g_playlist.previous();
+        g_inputPath = g_playlist.current();
+        g_inputChanged = true;
+    }
+
+    // Redraw the companion window once, for companionRate 0
+    if (keyPressed(window, GLFW_KEY_M))
+        g_companionRequested = true;
+
+    // Write the CPU trace recorded since the last one
+    if (keyPressed(window, GLFW_KEY_T))
+        g_traceRequested = true;
+
+    // Write the GPU pass times, same as the GPU window's Save CSV
+    if (keyPressed(window, GLFW_KEY_G))
+        g_gpuCsvRequested = true;
+
+    // Free the cursor to click the companion window's widgets, the camera holds still meanwhile
+    if (keyPressed(window, GLFW_KEY_TAB) && !headless) {
+        bool captured = glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED;
+        glfwSetInputMode(window, GLFW_CURSOR, captured ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+        firstMouse = true;
+    }
+
+    // Render settings, also on the companion window's checkboxes
+    if (keyPressed(window, GLFW_KEY_H)) {
+        useHiddenAreaMask = !useHiddenAreaMask;
+        g_fullClearRequested = true;
+        std::cout << "Hidden area mask " << (useHiddenAreaMask ? "on" : "off") << std::endl;
+    }
+    if (keyPressed(window, GLFW_KEY_Q)) {
+        scissorToQuad = !scissorToQuad;
+        g_fullClearRequested = true;
+        std::cout << "Scissor to quad " << (scissorToQuad ? "on" : "off") << std::endl;
+    }
+    if (keyPressed(window, GLFW_KEY_P)) {
+        predictPoses = !predictPoses;
+        std::cout << "Pose prediction " << (predictPoses ? "on" : "off") << std::endl;
+    }
+}
+
+// true on the frame key goes down, once per press
+bool keyPressed(GLFWwindow *window, int key)
+{
+    static bool held[GLFW_KEY_LAST + 1] = {};
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool first = pressed && !held[key];
+    held[key] = pressed;
+    return first;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -450,6 +1348,9 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+    if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED)
+        return;
+
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
 
@@ -0,0 +1,202 @@
+#ifndef MIP_BUILDER_H
+#define MIP_BUILDER_H
+
+// Builds mip chains on the CPU so that a huge upload is not followed by a synchronous
+// glGenerateMipmap on the render thread. Each level is split into row bands that run on
+// OpenCV's thread pool. Works on 8-bit images with 3 or 4 channels, the 4th is treated as alpha.
+
+#include "opencv2/opencv.hpp"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+enum MipFilter {
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER
+};
+
+// levels 1..n of a texture, level 0 is the source image itself
+typedef std::vector<cv::Mat> MipChain;
+
+class MipBuilder
+{
+public:
+    MipBuilder(MipFilter filter = MIP_FILTER_BOX, bool srgb = false)
+        : filter(filter), srgb(srgb)
+    {
+        buildWeights();
+        buildTables();
+    }
+
+    // tiles splits the image into a grid of independent images, e.g. 2 x 1 for both eyes of
+    // a side by side pair: no filter tap crosses from one tile into another at any level
+    MipChain build(const cv::Mat &base, cv::Size tiles = cv::Size(1, 1)) const
+    {
+        MipChain chain;
+        const cv::Mat *previous = &base;
+        while (previous->cols > 1 || previous->rows > 1)
+        {
+            chain.push_back(downsample(*previous, tiles));
+            previous = &chain.back();
+        }
+        return chain;
+    }
+
+    // single level, half the size of src rounded down (but at least 1) like GL's mip sizes
+    cv::Mat downsample(const cv::Mat &src, cv::Size tiles = cv::Size(1, 1)) const
+    {
+        int dstCols = std::max(1, src.cols / 2);
+        int dstRows = std::max(1, src.rows / 2);
+        cv::Mat dst(dstRows, dstCols, src.type());
+
+        // source columns each destination column may read, those of its own tile
+        std::vector<int> firstColumn(dstCols), lastColumn(dstCols);
+        for (int x = 0; x < dstCols; x++)
+        {
+            int tile = std::min(tiles.width - 1, x * tiles.width / dstCols);
+            firstColumn[x] = tile * src.cols / tiles.width;
+            lastColumn[x] = std::max(firstColumn[x], (tile + 1) * src.cols / tiles.width - 1);
+        }
+
+        cv::parallel_for_(cv::Range(0, dstRows), [&](const cv::Range &range) {
+            filterBand(src, dst, range.start, range.end, firstColumn, lastColumn, tiles.height);
+        });
+        return dst;
+    }
+
+private:
+    MipFilter filter;
+    bool srgb;
+
+    // source taps around a destination pixel, offsets are relative to its first source pixel
+    std::vector<int> offsets;
+    std::vector<float> weights;
+
+    float toLinear[256];
+    static const int FROM_LINEAR_SIZE = 4096;
+    uint8_t fromLinear[FROM_LINEAR_SIZE + 1];
+
+    void buildWeights()
+    {
+        if (filter == MIP_FILTER_BOX)
+        {
+            offsets = {0, 1};
+            weights = {0.5f, 0.5f};
+            return;
+        }
+
+        // Kaiser windowed sinc, 8 taps spanning 4 destination pixels
+        const float alpha = 4.0f;
+        const int radius = 4;
+        float sum = 0.0f;
+        for (int k = -radius + 1; k <= radius; k++)
+        {
+            float x = (k - 0.5f) / 2.0f;     // distance from the destination center, in destination pixels
+            float t = x / (radius / 2.0f);
+            float window = besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - t * t))) / besselI0(alpha);
+            float weight = sinc(x) * window;
+            offsets.push_back(k);
+            weights.push_back(weight);
+            sum += weight;
+        }
+        for (float &w : weights)
+            w /= sum;
+    }
+
+    void buildTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = srgb ? (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) : c;
+        }
+        for (int i = 0; i <= FROM_LINEAR_SIZE; i++)
+        {
+            float l = (float) i / FROM_LINEAR_SIZE;
+            float c = srgb ? (l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f) : l;
+            fromLinear[i] = (uint8_t) std::lround(std::min(1.0f, std::max(0.0f, c)) * 255.0f);
+        }
+    }
+
+    static float sinc(float x)
+    {
+        if (std::fabs(x) < 1e-6f)
+            return 1.0f;
+        float px = 3.14159265f * x;
+        return std::sin(px) / px;
+    }
+
+    static float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 16; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    uint8_t encode(float value, bool alpha) const
+    {
+        value = std::min(1.0f, std::max(0.0f, value));
+        if (alpha)
+            return (uint8_t) std::lround(value * 255.0f);
+        return fromLinear[(int) std::lround(value * FROM_LINEAR_SIZE)];
+    }
+
+    // Filters destination rows [rowBegin, rowEnd): a horizontal pass over just the source rows
+    // this band needs, then a vertical pass, so no full size intermediate is ever allocated.
+    // Taps are clamped to the tile of the destination pixel, see build().
+    void filterBand(const cv::Mat &src, cv::Mat &dst, int rowBegin, int rowEnd,
+                    const std::vector<int> &firstColumn, const std::vector<int> &lastColumn, int tileRows) const
+    {
+        const int channels = src.channels();
+        const int taps = (int) offsets.size();
+        const int srcRowBegin = std::max(0, 2 * rowBegin + offsets.front());
+        const int srcRowEnd = std::min(src.rows, 2 * (rowEnd - 1) + offsets.back() + 1);
+        const int rowFloats = dst.cols * channels;
+
+        std::vector<float> horizontal((size_t) (srcRowEnd - srcRowBegin) * rowFloats);
+        for (int sy = srcRowBegin; sy < srcRowEnd; sy++)
+        {
+            const uint8_t *in = src.ptr<uint8_t>(sy);
+            float *out = &horizontal[(size_t) (sy - srcRowBegin) * rowFloats];
+            for (int x = 0; x < dst.cols; x++)
+            {
+                for (int c = 0; c < channels; c++)
+                {
+                    bool alpha = c == 3;
+                    float sum = 0.0f;
+                    for (int t = 0; t < taps; t++)
+                    {
+                        int sx = std::min(lastColumn[x], std::max(firstColumn[x], 2 * x + offsets[t]));
+                        uint8_t v = in[sx * channels + c];
+                        sum += weights[t] * (alpha ? v / 255.0f : toLinear[v]);
+                    }
+                    out[x * channels + c] = sum;
+                }
+            }
+        }
+
+        for (int y = rowBegin; y < rowEnd; y++)
+        {
+            int tile = std::min(tileRows - 1, y * tileRows / dst.rows);
+            int firstRow = std::min(srcRowEnd - 1, std::max(srcRowBegin, tile * src.rows / tileRows));
+            int lastRow = std::max(firstRow, std::min(srcRowEnd - 1, (tile + 1) * src.rows / tileRows - 1));
+            uint8_t *out = dst.ptr<uint8_t>(y);
+            for (int i = 0; i < rowFloats; i++)
+            {
+                float sum = 0.0f;
+                for (int t = 0; t < taps; t++)
+                {
+                    int sy = std::min(lastRow, std::max(firstRow, 2 * y + offsets[t]));
+                    sum += weights[t] * horizontal[(size_t) (sy - srcRowBegin) * rowFloats + i];
+                }
+                out[i] = encode(sum, channels == 4 && i % channels == 3);
+            }
+        }
+    }
+};
+#endif
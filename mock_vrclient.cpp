@@ -0,0 +1,860 @@
+// Stand-in OpenVR runtime for machines without a headset or SteamVR, e.g. CI boxes.
+//
+// Builds as vrclient (vrclient_x64 on Windows), the library openvr_api loads from
+// <runtime>/bin/<platform>. Point the API at it with
+//
+//     VR_OVERRIDE=<build>/mock_vr VR_CONFIG_PATH=<dir> VR_LOG_PATH=<dir> ./GLVR image.jpg
+//
+// or with a runtime entry in openvrpaths.vrpath. VR_Init, VR_IsHmdPresent, IVRSystem and
+// IVRCompositor then behave like a headset on the desk, driven by environment variables:
+//
+//     MOCK_VR_REFRESH_HZ       vsync clock WaitGetPoses blocks on, 0 never blocks   (90)
+//     MOCK_VR_RENDER_WIDTH     recommended render target size                        (1440)
+//     MOCK_VR_RENDER_HEIGHT                                                          (1600)
+//     MOCK_VR_IPD              eye separation in meters                              (0.063)
+//     MOCK_VR_SWAY_DEGREES     amplitude of a synthetic head yaw, 0 holds the head still (0)
+//     MOCK_VR_QUIT_AFTER       sends VREvent_Quit after this many frames, 0 never    (0)
+//     MOCK_VR_HIDDEN_AREA      1 hides all but an ellipse per eye, like a round lens (1)
+//     MOCK_VR_CAPTURE_DIR      writes submitted eye textures here as PPM
+//     MOCK_VR_CAPTURE_EVERY    capture every Nth frame                               (1)
+//
+// Frame timings are real CPU measurements, the GPU fields hold the time from WaitGetPoses to
+// the second Submit since the runtime has no view of the GPU.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include <GL/gl.h>
+
+#include "openvr.h"
+#include "ivrclientcore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_TEXTURE_BINDING_2D_ARRAY
+#define GL_TEXTURE_BINDING_2D_ARRAY 0x8C1D
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#if defined(_WIN32)
+#define MOCK_VR_EXPORT extern "C" __declspec(dllexport)
+#else
+#define MOCK_VR_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double envNumber(const char *name, double fallback)
+{
+    const char *value = getenv(name);
+    return value && *value ? atof(value) : fallback;
+}
+
+std::string envString(const char *name)
+{
+    const char *value = getenv(name);
+    return value ? value : "";
+}
+
+struct MockSettings
+{
+    double refreshHz = 90.0;
+    uint32_t renderWidth = 1440;
+    uint32_t renderHeight = 1600;
+    float ipd = 0.063f;
+    float swayDegrees = 0.0f;
+    uint32_t quitAfter = 0;
+    bool hiddenArea = true;
+    std::string captureDir;
+    uint32_t captureEvery = 1;
+
+    void read()
+    {
+        refreshHz = std::max(0.0, envNumber("MOCK_VR_REFRESH_HZ", refreshHz));
+        renderWidth = (uint32_t) envNumber("MOCK_VR_RENDER_WIDTH", renderWidth);
+        renderHeight = (uint32_t) envNumber("MOCK_VR_RENDER_HEIGHT", renderHeight);
+        ipd = (float) envNumber("MOCK_VR_IPD", ipd);
+        swayDegrees = (float) envNumber("MOCK_VR_SWAY_DEGREES", swayDegrees);
+        quitAfter = (uint32_t) envNumber("MOCK_VR_QUIT_AFTER", quitAfter);
+        hiddenArea = envNumber("MOCK_VR_HIDDEN_AREA", hiddenArea ? 1.0 : 0.0) != 0.0;
+        captureDir = envString("MOCK_VR_CAPTURE_DIR");
+        captureEvery = std::max(1u, (uint32_t) envNumber("MOCK_VR_CAPTURE_EVERY", captureEvery));
+    }
+};
+
+// Shared state of the fake headset: settings, the vsync clock and the frame being built
+struct MockRuntime
+{
+    MockSettings settings;
+    Clock::time_point start = Clock::now();
+    vr::ETrackingUniverseOrigin trackingSpace = vr::TrackingUniverseStanding;
+
+    uint32_t frameIndex = 0;
+    bool quitSent = false;
+
+    double secondsNow() const
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double framePeriod() const
+    {
+        return settings.refreshHz > 0.0 ? 1.0 / settings.refreshHz : 0.0;
+    }
+
+    uint64_t vsyncCount(double seconds) const
+    {
+        return settings.refreshHz > 0.0 ? (uint64_t) (seconds * settings.refreshHz) : frameIndex;
+    }
+
+    // head pose at seconds, a slow yaw around the origin when swaying
+    vr::HmdMatrix34_t headPose(double seconds) const
+    {
+        float yaw = settings.swayDegrees * 3.14159265f / 180.0f * (float) std::sin(seconds * 2.0 * 3.14159265 / 4.0);
+        float c = std::cos(yaw), s = std::sin(yaw);
+        vr::HmdMatrix34_t pose = {{
+            {c, 0.0f, s, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {-s, 0.0f, c, 0.0f}
+        }};
+        return pose;
+    }
+
+    void fillPoses(vr::TrackedDevicePose_t *poses, uint32_t count, double seconds) const
+    {
+        for (uint32_t i = 0; i < count; i++) {
+            poses[i] = {};
+            poses[i].eTrackingResult = vr::TrackingResult_Uninitialized;
+        }
+        if (count == 0)
+            return;
+        poses[0].mDeviceToAbsoluteTracking = headPose(seconds);
+        poses[0].bPoseIsValid = true;
+        poses[0].bDeviceIsConnected = true;
+        poses[0].eTrackingResult = vr::TrackingResult_Running_OK;
+    }
+};
+
+MockRuntime runtime;
+
+typedef void (*GLProc)();
+
+#ifdef _WIN32
+// opengl32 exports the 1.1 entry points for every WGL context
+GLProc contextProc(const char *name)
+{
+    HMODULE opengl = GetModuleHandleA("opengl32.dll");
+    return opengl ? (GLProc) GetProcAddress(opengl, name) : nullptr;
+}
+#else
+// first of names the process already has loaded, never loads a library itself
+void *loadedLibrary(std::initializer_list<const char *> names)
+{
+    for (const char *name : names)
+        if (void *library = dlopen(name, RTLD_LAZY | RTLD_NOLOAD))
+            return library;
+    return nullptr;
+}
+
+// name looked up through whichever of OSMesa, EGL or GLX owns the current context. The app
+// may render offscreen with OSMesa or EGL, where libGL's own exports reach no context.
+GLProc contextProc(const char *name)
+{
+    typedef void *(*GetCurrent)();
+    typedef GLProc (*GetProc)(const char *);
+
+    if (void *osmesa = loadedLibrary({"libOSMesa.so.8", "libOSMesa.so.6", "libOSMesa.so"})) {
+        GetCurrent current = (GetCurrent) dlsym(osmesa, "OSMesaGetCurrentContext");
+        GetProc proc = (GetProc) dlsym(osmesa, "OSMesaGetProcAddress");
+        if (current && proc && current())
+            return proc(name);
+    }
+    if (void *egl = loadedLibrary({"libEGL.so.1", "libEGL.so"})) {
+        GetCurrent current = (GetCurrent) dlsym(egl, "eglGetCurrentContext");
+        GetProc proc = (GetProc) dlsym(egl, "eglGetProcAddress");
+        if (current && proc && current())
+            if (GLProc address = proc(name))
+                return address;
+    }
+    if (void *glx = loadedLibrary({"libGLX.so.0", "libGL.so.1", "libGL.so"})) {
+        GetCurrent current = (GetCurrent) dlsym(glx, "glXGetCurrentContext");
+        GetProc proc = (GetProc) dlsym(glx, "glXGetProcAddressARB");
+        if (current && proc && current())
+            return proc(name);
+    }
+    return (GLProc) dlsym(RTLD_DEFAULT, name);
+}
+#endif
+
+// The GL calls captureTexture makes, resolved against the current context on every capture
+struct CaptureGL
+{
+    void (APIENTRY *getIntegerv)(GLenum, GLint *);
+    void (APIENTRY *bindTexture)(GLenum, GLuint);
+    void (APIENTRY *getTexLevelParameteriv)(GLenum, GLint, GLenum, GLint *);
+    void (APIENTRY *pixelStorei)(GLenum, GLint);
+    void (APIENTRY *getTexImage)(GLenum, GLint, GLenum, GLenum, void *);
+
+    bool resolve()
+    {
+        getIntegerv = (decltype(getIntegerv)) contextProc("glGetIntegerv");
+        bindTexture = (decltype(bindTexture)) contextProc("glBindTexture");
+        getTexLevelParameteriv = (decltype(getTexLevelParameteriv)) contextProc("glGetTexLevelParameteriv");
+        pixelStorei = (decltype(pixelStorei)) contextProc("glPixelStorei");
+        getTexImage = (decltype(getTexImage)) contextProc("glGetTexImage");
+        return getIntegerv && bindTexture && getTexLevelParameteriv && pixelStorei && getTexImage;
+    }
+};
+
+// Writes the bounds of layer of an RGBA texture as a binary PPM
+void captureTexture(const vr::Texture_t *texture, const vr::VRTextureBounds_t *bounds, bool arrayTexture, int layer,
+                    const std::string &path)
+{
+    if (texture->eType != vr::TextureType_OpenGL)
+        return;
+    CaptureGL gl;
+    if (!gl.resolve())
+        return;
+    GLuint name = (GLuint) (uintptr_t) texture->handle;
+    GLenum target = arrayTexture ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+    GLint previous = 0;
+    gl.getIntegerv(arrayTexture ? GL_TEXTURE_BINDING_2D_ARRAY : GL_TEXTURE_BINDING_2D, &previous);
+    gl.bindTexture(target, name);
+    GLint width = 0, height = 0, layers = 1;
+    gl.getTexLevelParameteriv(target, 0, GL_TEXTURE_WIDTH, &width);
+    gl.getTexLevelParameteriv(target, 0, GL_TEXTURE_HEIGHT, &height);
+    if (arrayTexture)
+        gl.getTexLevelParameteriv(target, 0, 0x8071 /* GL_TEXTURE_DEPTH */, &layers);
+    if (width <= 0 || height <= 0 || layer >= layers) {
+        gl.bindTexture(target, previous);
+        return;
+    }
+    std::vector<unsigned char> pixels((size_t) width * height * layers * 4);
+    gl.pixelStorei(GL_PACK_ALIGNMENT, 1);
+    gl.getTexImage(target, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    gl.bindTexture(target, previous);
+
+    // bounds run top down, GL rows bottom up
+    vr::VRTextureBounds_t area = bounds ? *bounds : vr::VRTextureBounds_t{0.0f, 0.0f, 1.0f, 1.0f};
+    int x0 = (int) (std::min(area.uMin, area.uMax) * width);
+    int x1 = (int) (std::max(area.uMin, area.uMax) * width);
+    int rowTop = (int) ((1.0f - std::min(area.vMin, area.vMax)) * height) - 1;
+    int rowBottom = (int) ((1.0f - std::max(area.vMin, area.vMax)) * height);
+    x0 = std::max(0, x0);
+    x1 = std::min(width, x1);
+    rowTop = std::min(height - 1, rowTop);
+    rowBottom = std::max(0, rowBottom);
+    if (x1 <= x0 || rowTop < rowBottom)
+        return;
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return;
+    fprintf(file, "P6\n%d %d\n255\n", x1 - x0, rowTop - rowBottom + 1);
+    const unsigned char *layerPixels = pixels.data() + (size_t) width * height * 4 * layer;
+    std::vector<unsigned char> row((size_t) (x1 - x0) * 3);
+    for (int y = rowTop; y >= rowBottom; y--) {
+        for (int x = x0; x < x1; x++)
+            memcpy(&row[(x - x0) * 3], layerPixels + ((size_t) y * width + x) * 4, 3);
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    fclose(file);
+}
+
+class MockSystem : public vr::IVRSystem
+{
+public:
+    void GetRecommendedRenderTargetSize(uint32_t *pnWidth, uint32_t *pnHeight) override
+    {
+        *pnWidth = runtime.settings.renderWidth;
+        *pnHeight = runtime.settings.renderHeight;
+    }
+
+    vr::HmdMatrix44_t GetProjectionMatrix(vr::EVREye eEye, float fNearZ, float fFarZ) override
+    {
+        float left, right, top, bottom;
+        GetProjectionRaw(eEye, &left, &right, &top, &bottom);
+        float idx = 1.0f / (right - left);
+        float idy = 1.0f / (bottom - top);
+        float idz = 1.0f / (fFarZ - fNearZ);
+        vr::HmdMatrix44_t projection = {{
+            {2.0f * idx, 0.0f, (right + left) * idx, 0.0f},
+            {0.0f, 2.0f * idy, (bottom + top) * idy, 0.0f},
+            {0.0f, 0.0f, -fFarZ * idz, -fFarZ * fNearZ * idz},
+            {0.0f, 0.0f, -1.0f, 0.0f}
+        }};
+        return projection;
+    }
+
+    // tangents of a roughly 100 degree headset, a little wider toward the outside of each eye
+    void GetProjectionRaw(vr::EVREye eEye, float *pfLeft, float *pfRight, float *pfTop, float *pfBottom) override
+    {
+        *pfLeft = eEye == vr::Eye_Left ? -1.3f : -1.1f;
+        *pfRight = eEye == vr::Eye_Left ? 1.1f : 1.3f;
+        *pfTop = -1.2f;
+        *pfBottom = 1.2f;
+    }
+
+    bool ComputeDistortion(vr::EVREye, float fU, float fV, vr::DistortionCoordinates_t *pDistortionCoordinates) override
+    {
+        for (float *channel : {pDistortionCoordinates->rfRed, pDistortionCoordinates->rfGreen, pDistortionCoordinates->rfBlue}) {
+            channel[0] = fU;
+            channel[1] = fV;
+        }
+        return true;
+    }
+
+    vr::HmdMatrix34_t GetEyeToHeadTransform(vr::EVREye eEye) override
+    {
+        float offset = (eEye == vr::Eye_Left ? -0.5f : 0.5f) * runtime.settings.ipd;
+        vr::HmdMatrix34_t transform = {{
+            {1.0f, 0.0f, 0.0f, offset},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f}
+        }};
+        return transform;
+    }
+
+    bool GetTimeSinceLastVsync(float *pfSecondsSinceLastVsync, uint64_t *pulFrameCounter) override
+    {
+        double now = runtime.secondsNow();
+        double period = runtime.framePeriod();
+        if (pfSecondsSinceLastVsync)
+            *pfSecondsSinceLastVsync = period > 0.0 ? (float) std::fmod(now, period) : 0.0f;
+        if (pulFrameCounter)
+            *pulFrameCounter = runtime.vsyncCount(now);
+        return true;
+    }
+
+    int32_t GetD3D9AdapterIndex() override { return 0; }
+    void GetDXGIOutputInfo(int32_t *pnAdapterIndex) override { *pnAdapterIndex = 0; }
+    void GetOutputDevice(uint64_t *pnDevice, vr::ETextureType, VkInstance_T *) override { *pnDevice = 0; }
+    bool IsDisplayOnDesktop() override { return false; }
+    bool SetDisplayVisibility(bool) override { return false; }
+
+    void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin, float fPredictedSecondsToPhotonsFromNow,
+                                         vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override
+    {
+        runtime.fillPoses(pTrackedDevicePoseArray, unTrackedDevicePoseArrayCount, runtime.secondsNow() + fPredictedSecondsToPhotonsFromNow);
+    }
+
+    vr::HmdMatrix34_t GetSeatedZeroPoseToStandingAbsoluteTrackingPose() override { return identity(); }
+    vr::HmdMatrix34_t GetRawZeroPoseToStandingAbsoluteTrackingPose() override { return identity(); }
+
+    uint32_t GetSortedTrackedDeviceIndicesOfClass(vr::ETrackedDeviceClass eTrackedDeviceClass, vr::TrackedDeviceIndex_t *punTrackedDeviceIndexArray,
+                                                  uint32_t unTrackedDeviceIndexArrayCount, vr::TrackedDeviceIndex_t) override
+    {
+        if (eTrackedDeviceClass != vr::TrackedDeviceClass_HMD)
+            return 0;
+        if (punTrackedDeviceIndexArray && unTrackedDeviceIndexArrayCount > 0)
+            punTrackedDeviceIndexArray[0] = vr::k_unTrackedDeviceIndex_Hmd;
+        return 1;
+    }
+
+    vr::EDeviceActivityLevel GetTrackedDeviceActivityLevel(vr::TrackedDeviceIndex_t) override { return vr::k_EDeviceActivityLevel_UserInteraction; }
+
+    void ApplyTransform(vr::TrackedDevicePose_t *pOutputPose, const vr::TrackedDevicePose_t *pTrackedDevicePose, const vr::HmdMatrix34_t *pTransform) override
+    {
+        *pOutputPose = *pTrackedDevicePose;
+        const vr::HmdMatrix34_t &a = *pTransform;
+        const vr::HmdMatrix34_t &b = pTrackedDevicePose->mDeviceToAbsoluteTracking;
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 4; column++) {
+                float value = column == 3 ? a.m[row][3] : 0.0f;
+                for (int k = 0; k < 3; k++)
+                    value += a.m[row][k] * b.m[k][column];
+                pOutputPose->mDeviceToAbsoluteTracking.m[row][column] = value;
+            }
+        }
+    }
+
+    vr::TrackedDeviceIndex_t GetTrackedDeviceIndexForControllerRole(vr::ETrackedControllerRole) override { return vr::k_unTrackedDeviceIndexInvalid; }
+    vr::ETrackedControllerRole GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t) override { return vr::TrackedControllerRole_Invalid; }
+
+    vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t unDeviceIndex) override
+    {
+        return unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd ? vr::TrackedDeviceClass_HMD : vr::TrackedDeviceClass_Invalid;
+    }
+
+    bool IsTrackedDeviceConnected(vr::TrackedDeviceIndex_t unDeviceIndex) override
+    {
+        return unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd;
+    }
+
+    bool GetBoolTrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError) override
+    {
+        return unknownProperty(pError, false);
+    }
+
+    float GetFloatTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, vr::ETrackedPropertyError *pError) override
+    {
+        if (unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd) {
+            if (prop == vr::Prop_DisplayFrequency_Float && runtime.settings.refreshHz > 0.0)
+                return success(pError, (float) runtime.settings.refreshHz);
+            if (prop == vr::Prop_SecondsFromVsyncToPhotons_Float)
+                return success(pError, 0.011f);
+            if (prop == vr::Prop_UserIpdMeters_Float)
+                return success(pError, runtime.settings.ipd);
+        }
+        return unknownProperty(pError, 0.0f);
+    }
+
+    int32_t GetInt32TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError) override
+    {
+        return unknownProperty(pError, 0);
+    }
+
+    uint64_t GetUint64TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError) override
+    {
+        return unknownProperty<uint64_t>(pError, 0);
+    }
+
+    vr::HmdMatrix34_t GetMatrix34TrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::ETrackedPropertyError *pError) override
+    {
+        return unknownProperty(pError, identity());
+    }
+
+    uint32_t GetArrayTrackedDeviceProperty(vr::TrackedDeviceIndex_t, vr::ETrackedDeviceProperty, vr::PropertyTypeTag_t, void *, uint32_t,
+                                           vr::ETrackedPropertyError *pError) override
+    {
+        return unknownProperty(pError, 0u);
+    }
+
+    uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t unDeviceIndex, vr::ETrackedDeviceProperty prop, char *pchValue,
+                                            uint32_t unBufferSize, vr::ETrackedPropertyError *pError) override
+    {
+        const char *value = nullptr;
+        if (unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd && prop == vr::Prop_ModelNumber_String)
+            value = "Mock HMD";
+        else if (unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd && prop == vr::Prop_TrackingSystemName_String)
+            value = "mock";
+        if (!value)
+            return unknownProperty(pError, 0u);
+        uint32_t size = (uint32_t) strlen(value) + 1;
+        if (!pchValue || unBufferSize < size)
+            return failure(pError, vr::TrackedProp_BufferTooSmall, size);
+        memcpy(pchValue, value, size);
+        return success(pError, size);
+    }
+
+    const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override
+    {
+        return error == vr::TrackedProp_Success ? "TrackedProp_Success" : "TrackedProp_Error";
+    }
+
+    // only ever a quit, once MOCK_VR_QUIT_AFTER frames have been submitted
+    bool PollNextEvent(vr::VREvent_t *pEvent, uint32_t uncbVREvent) override
+    {
+        if (runtime.quitSent || runtime.settings.quitAfter == 0 || runtime.frameIndex < runtime.settings.quitAfter)
+            return false;
+        memset(pEvent, 0, std::min<size_t>(uncbVREvent, sizeof(vr::VREvent_t)));
+        pEvent->eventType = vr::VREvent_Quit;
+        runtime.quitSent = true;
+        return true;
+    }
+
+    bool PollNextEventWithPose(vr::ETrackingUniverseOrigin, vr::VREvent_t *pEvent, uint32_t uncbVREvent, vr::TrackedDevicePose_t *pTrackedDevicePose) override
+    {
+        if (pTrackedDevicePose)
+            runtime.fillPoses(pTrackedDevicePose, 1, runtime.secondsNow());
+        return PollNextEvent(pEvent, uncbVREvent);
+    }
+
+    const char *GetEventTypeNameFromEnum(vr::EVREventType eType) override
+    {
+        return eType == vr::VREvent_Quit ? "VREvent_Quit" : "VREvent_Unknown";
+    }
+
+    // no lens mask, every pixel is visible
+    // Everything outside the ellipse inscribed in the render target, about 21% of it, as a ring
+    // of quads between the ellipse and the border. The rays at 45 degrees hit the corners, so
+    // every quad lies along a single side.
+    vr::HiddenAreaMesh_t GetHiddenAreaMesh(vr::EVREye, vr::EHiddenAreaMeshType type) override
+    {
+        if (!runtime.settings.hiddenArea || type != vr::k_eHiddenAreaMesh_Standard)
+            return {nullptr, 0};
+        if (hiddenArea.empty()) {
+            const int segments = 64;
+            auto ring = [](int i, bool border) {
+                float angle = 2.0f * 3.14159265f * i / segments;
+                float x = std::cos(angle), y = std::sin(angle);
+                float scale = border ? 1.0f / std::max(std::fabs(x), std::fabs(y)) : 1.0f;
+                return vr::HmdVector2_t{{0.5f + 0.5f * x * scale, 0.5f + 0.5f * y * scale}};
+            };
+            for (int i = 0; i < segments; i++) {
+                vr::HmdVector2_t inner0 = ring(i, false), inner1 = ring(i + 1, false);
+                vr::HmdVector2_t outer0 = ring(i, true), outer1 = ring(i + 1, true);
+                hiddenArea.insert(hiddenArea.end(), {inner0, outer0, outer1, inner0, outer1, inner1});
+            }
+        }
+        return {hiddenArea.data(), (uint32_t) hiddenArea.size() / 3};
+    }
+
+    bool GetControllerState(vr::TrackedDeviceIndex_t, vr::VRControllerState_t *, uint32_t) override { return false; }
+    bool GetControllerStateWithPose(vr::ETrackingUniverseOrigin, vr::TrackedDeviceIndex_t, vr::VRControllerState_t *, uint32_t,
+                                    vr::TrackedDevicePose_t *) override { return false; }
+    void TriggerHapticPulse(vr::TrackedDeviceIndex_t, uint32_t, unsigned short) override {}
+    const char *GetButtonIdNameFromEnum(vr::EVRButtonId) override { return "k_EButton_Unknown"; }
+    const char *GetControllerAxisTypeNameFromEnum(vr::EVRControllerAxisType) override { return "k_eControllerAxis_None"; }
+    bool IsInputAvailable() override { return true; }
+    bool IsSteamVRDrawingControllers() override { return false; }
+    bool ShouldApplicationPause() override { return false; }
+    bool ShouldApplicationReduceRenderingWork() override { return false; }
+    vr::EVRFirmwareError PerformFirmwareUpdate(vr::TrackedDeviceIndex_t) override { return vr::VRFirmwareError_None; }
+    void AcknowledgeQuit_Exiting() override {}
+
+    uint32_t GetAppContainerFilePaths(char *pchBuffer, uint32_t unBufferSize) override
+    {
+        if (pchBuffer && unBufferSize > 0)
+            pchBuffer[0] = '\0';
+        return 1;
+    }
+
+    const char *GetRuntimeVersion() override { return "mock"; }
+
+private:
+    std::vector<vr::HmdVector2_t> hiddenArea;
+
+    static vr::HmdMatrix34_t identity()
+    {
+        return {{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}}};
+    }
+
+    template <typename T>
+    static T success(vr::ETrackedPropertyError *pError, T value)
+    {
+        if (pError)
+            *pError = vr::TrackedProp_Success;
+        return value;
+    }
+
+    template <typename T>
+    static T failure(vr::ETrackedPropertyError *pError, vr::ETrackedPropertyError error, T value)
+    {
+        if (pError)
+            *pError = error;
+        return value;
+    }
+
+    template <typename T>
+    static T unknownProperty(vr::ETrackedPropertyError *pError, T value)
+    {
+        return failure(pError, vr::TrackedProp_UnknownProperty, value);
+    }
+};
+
+class MockCompositor : public vr::IVRCompositor
+{
+public:
+    void SetTrackingSpace(vr::ETrackingUniverseOrigin eOrigin) override { runtime.trackingSpace = eOrigin; }
+    vr::ETrackingUniverseOrigin GetTrackingSpace() override { return runtime.trackingSpace; }
+
+    // Blocks until the next vsync of the clock, as the real compositor's running start would
+    vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t *pRenderPoseArray, uint32_t unRenderPoseArrayCount,
+                                        vr::TrackedDevicePose_t *pGamePoseArray, uint32_t unGamePoseArrayCount) override
+    {
+        double called = runtime.secondsNow();
+        double period = runtime.framePeriod();
+        double vsync = called;
+        if (period > 0.0) {
+            uint64_t next = runtime.vsyncCount(called) + 1;
+            vsync = next * period;
+            std::this_thread::sleep_until(runtime.start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(vsync)));
+        }
+
+        Frame frame;
+        frame.timing.m_nSize = sizeof(vr::Compositor_FrameTiming);
+        frame.timing.m_nFrameIndex = ++runtime.frameIndex;
+        frame.timing.m_nNumFramePresents = 1;
+        frame.timing.m_flSystemTimeInSeconds = vsync;
+        frame.timing.m_flWaitGetPosesCalledMs = (float) ((called - vsync) * 1000.0);
+        frame.timing.m_flNewPosesReadyMs = 0.0f;
+        if (!frames.empty()) {
+            const vr::Compositor_FrameTiming &previous = frames.back().timing;
+            frame.timing.m_flClientFrameIntervalMs = (float) ((vsync - previous.m_flSystemTimeInSeconds) * 1000.0);
+            // vsyncs between the two frames beyond the first showed the previous frame again
+            if (period > 0.0) {
+                uint32_t missed = (uint32_t) std::max(0.0, std::round((vsync - previous.m_flSystemTimeInSeconds) / period) - 1.0);
+                frame.timing.m_nNumDroppedFrames = missed;
+                if (missed)
+                    frame.timing.m_nReprojectionFlags |= vr::VRCompositor_ReprojectionReason_Cpu;
+            }
+        }
+        frames.push_back(frame);
+        if (frames.size() > HISTORY)
+            frames.erase(frames.begin());
+
+        // photons land about a frame after this vsync
+        double photons = vsync + period + 0.011;
+        runtime.fillPoses(pRenderPoseArray, unRenderPoseArrayCount, photons);
+        if (pGamePoseArray)
+            runtime.fillPoses(pGamePoseArray, unGamePoseArrayCount, photons + period);
+        if (unRenderPoseArrayCount > 0)
+            frames.back().timing.m_HmdPose = pRenderPoseArray[0];
+        lastRenderPose = pRenderPoseArray && unRenderPoseArrayCount > 0 ? pRenderPoseArray[0] : vr::TrackedDevicePose_t{};
+        return vr::VRCompositorError_None;
+    }
+
+    vr::EVRCompositorError GetLastPoses(vr::TrackedDevicePose_t *pRenderPoseArray, uint32_t unRenderPoseArrayCount,
+                                        vr::TrackedDevicePose_t *pGamePoseArray, uint32_t unGamePoseArrayCount) override
+    {
+        double seconds = frames.empty() ? runtime.secondsNow() : frames.back().timing.m_flSystemTimeInSeconds;
+        runtime.fillPoses(pRenderPoseArray, unRenderPoseArrayCount, seconds);
+        if (pGamePoseArray)
+            runtime.fillPoses(pGamePoseArray, unGamePoseArrayCount, seconds);
+        return vr::VRCompositorError_None;
+    }
+
+    vr::EVRCompositorError GetLastPoseForTrackedDeviceIndex(vr::TrackedDeviceIndex_t unDeviceIndex, vr::TrackedDevicePose_t *pOutputPose,
+                                                            vr::TrackedDevicePose_t *pOutputGamePose) override
+    {
+        if (unDeviceIndex >= vr::k_unMaxTrackedDeviceCount)
+            return vr::VRCompositorError_IndexOutOfRange;
+        vr::TrackedDevicePose_t pose = unDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd ? lastRenderPose : vr::TrackedDevicePose_t{};
+        if (pOutputPose)
+            *pOutputPose = pose;
+        if (pOutputGamePose)
+            *pOutputGamePose = pose;
+        return vr::VRCompositorError_None;
+    }
+
+    vr::EVRCompositorError Submit(vr::EVREye eEye, const vr::Texture_t *pTexture, const vr::VRTextureBounds_t *pBounds,
+                                  vr::EVRSubmitFlags nSubmitFlags) override
+    {
+        if (frames.empty())
+            return vr::VRCompositorError_DoNotHaveFocus;
+        if (!pTexture || !pTexture->handle)
+            return vr::VRCompositorError_InvalidTexture;
+        Frame &frame = frames.back();
+        if (frame.submitted[eEye])
+            return vr::VRCompositorError_AlreadySubmitted;
+        frame.submitted[eEye] = true;
+
+        if (frame.submitted[0] && frame.submitted[1]) {
+            double ready = runtime.secondsNow() - frame.timing.m_flSystemTimeInSeconds;
+            frame.timing.m_flNewFrameReadyMs = (float) (ready * 1000.0);
+            frame.timing.m_flPreSubmitGpuMs = std::max(0.0f, frame.timing.m_flNewFrameReadyMs - frame.timing.m_flNewPosesReadyMs);
+        }
+
+        const MockSettings &settings = runtime.settings;
+        if (!settings.captureDir.empty() && frame.timing.m_nFrameIndex % settings.captureEvery == 0) {
+            char name[64];
+            snprintf(name, sizeof(name), "/frame_%06u_%s.ppm", frame.timing.m_nFrameIndex, eEye == vr::Eye_Left ? "left" : "right");
+            bool arrayTexture = (nSubmitFlags & vr::Submit_GlArrayTexture) != 0;
+            captureTexture(pTexture, pBounds, arrayTexture, arrayTexture ? (int) eEye : 0, settings.captureDir + name);
+        }
+        return vr::VRCompositorError_None;
+    }
+
+    void ClearLastSubmittedFrame() override {}
+    void PostPresentHandoff() override {}
+
+    bool GetFrameTiming(vr::Compositor_FrameTiming *pTiming, uint32_t unFramesAgo) override
+    {
+        if (frames.empty())
+            return false;
+        size_t index = frames.size() - 1 - std::min<size_t>(unFramesAgo, frames.size() - 1);
+        copyTiming(pTiming, frames[index].timing);
+        return true;
+    }
+
+    // oldest to newest, the newest being the frame in progress
+    uint32_t GetFrameTimings(vr::Compositor_FrameTiming *pTiming, uint32_t nFrames) override
+    {
+        if (!pTiming || nFrames == 0)
+            return 0;
+        uint32_t count = (uint32_t) std::min<size_t>(nFrames, frames.size());
+        // an unset m_nSize means this header's struct, like copyTiming
+        uint32_t size = pTiming[0].m_nSize ? pTiming[0].m_nSize : (uint32_t) sizeof(vr::Compositor_FrameTiming);
+        size_t first = frames.size() - count;
+        for (uint32_t i = 0; i < count; i++) {
+            vr::Compositor_FrameTiming *out = (vr::Compositor_FrameTiming *) ((char *) pTiming + (size_t) i * size);
+            out->m_nSize = size;
+            copyTiming(out, frames[first + i].timing);
+        }
+        return count;
+    }
+
+    float GetFrameTimeRemaining() override
+    {
+        double period = runtime.framePeriod();
+        if (period <= 0.0)
+            return 0.0f;
+        return (float) (period - std::fmod(runtime.secondsNow(), period));
+    }
+
+    void GetCumulativeStats(vr::Compositor_CumulativeStats *pStats, uint32_t nStatsSizeInBytes) override
+    {
+        memset(pStats, 0, nStatsSizeInBytes);
+    }
+
+    void FadeToColor(float, float, float, float, float, bool) override {}
+    vr::HmdColor_t GetCurrentFadeColor(bool) override { return {0.0f, 0.0f, 0.0f, 0.0f}; }
+    void FadeGrid(float, bool) override {}
+    float GetCurrentGridAlpha() override { return 0.0f; }
+    vr::EVRCompositorError SetSkyboxOverride(const vr::Texture_t *, uint32_t) override { return vr::VRCompositorError_None; }
+    void ClearSkyboxOverride() override {}
+    void CompositorBringToFront() override {}
+    void CompositorGoToBack() override {}
+    void CompositorQuit() override {}
+    bool IsFullscreen() override { return false; }
+    uint32_t GetCurrentSceneFocusProcess() override { return 0; }
+    uint32_t GetLastFrameRenderer() override { return 0; }
+    bool CanRenderScene() override { return true; }
+    void ShowMirrorWindow() override {}
+    void HideMirrorWindow() override {}
+    bool IsMirrorWindowVisible() override { return false; }
+    void CompositorDumpImages() override {}
+    bool ShouldAppRenderWithLowResources() override { return false; }
+    void ForceInterleavedReprojectionOn(bool) override {}
+    void ForceReconnectProcess() override {}
+    void SuspendRendering(bool) override {}
+    vr::EVRCompositorError GetMirrorTextureD3D11(vr::EVREye, void *, void **) override { return vr::VRCompositorError_RequestFailed; }
+    void ReleaseMirrorTextureD3D11(void *) override {}
+    vr::EVRCompositorError GetMirrorTextureGL(vr::EVREye, vr::glUInt_t *, vr::glSharedTextureHandle_t *) override { return vr::VRCompositorError_RequestFailed; }
+    bool ReleaseSharedGLTexture(vr::glUInt_t, vr::glSharedTextureHandle_t) override { return false; }
+    void LockGLSharedTextureForAccess(vr::glSharedTextureHandle_t) override {}
+    void UnlockGLSharedTextureForAccess(vr::glSharedTextureHandle_t) override {}
+
+    uint32_t GetVulkanInstanceExtensionsRequired(char *pchValue, uint32_t unBufferSize) override
+    {
+        if (pchValue && unBufferSize > 0)
+            pchValue[0] = '\0';
+        return 1;
+    }
+
+    uint32_t GetVulkanDeviceExtensionsRequired(VkPhysicalDevice_T *, char *pchValue, uint32_t unBufferSize) override
+    {
+        return GetVulkanInstanceExtensionsRequired(pchValue, unBufferSize);
+    }
+
+    void SetExplicitTimingMode(vr::EVRCompositorTimingMode) override {}
+    vr::EVRCompositorError SubmitExplicitTimingData() override { return vr::VRCompositorError_None; }
+    bool IsMotionSmoothingEnabled() override { return false; }
+    bool IsMotionSmoothingSupported() override { return false; }
+    bool IsCurrentSceneFocusAppLoading() override { return false; }
+    vr::EVRCompositorError SetStageOverride_Async(const char *, const vr::HmdMatrix34_t *, const vr::Compositor_StageRenderSettings *, uint32_t) override
+    {
+        return vr::VRCompositorError_None;
+    }
+    void ClearStageOverride() override {}
+    bool GetCompositorBenchmarkResults(vr::Compositor_BenchmarkResults *, uint32_t) override { return false; }
+
+    vr::EVRCompositorError GetLastPosePredictionIDs(uint32_t *pRenderPosePredictionID, uint32_t *pGamePosePredictionID) override
+    {
+        if (pRenderPosePredictionID)
+            *pRenderPosePredictionID = runtime.frameIndex;
+        if (pGamePosePredictionID)
+            *pGamePosePredictionID = runtime.frameIndex;
+        return vr::VRCompositorError_None;
+    }
+
+    vr::EVRCompositorError GetPosesForFrame(uint32_t, vr::TrackedDevicePose_t *pPoseArray, uint32_t unPoseArrayCount) override
+    {
+        return GetLastPoses(pPoseArray, unPoseArrayCount, nullptr, 0);
+    }
+
+private:
+    static const size_t HISTORY = 128;
+
+    struct Frame
+    {
+        vr::Compositor_FrameTiming timing = {};
+        bool submitted[2] = {false, false};
+    };
+
+    std::vector<Frame> frames;
+    vr::TrackedDevicePose_t lastRenderPose = {};
+
+    // copies no more than the caller's struct holds
+    static void copyTiming(vr::Compositor_FrameTiming *out, const vr::Compositor_FrameTiming &timing)
+    {
+        uint32_t size = std::min<uint32_t>(out->m_nSize ? out->m_nSize : sizeof(timing), sizeof(timing));
+        memcpy(out, &timing, size);
+        out->m_nSize = size;
+    }
+};
+
+class MockClientCore : public vr::IVRClientCore
+{
+public:
+    vr::EVRInitError Init(vr::EVRApplicationType, const char *) override
+    {
+        // IVROverlay is not mocked, the app's overlay mode falls back to scene rendering
+        runtime = MockRuntime();
+        runtime.settings.read();
+        system.reset(new MockSystem());
+        compositor.reset(new MockCompositor());
+        return vr::VRInitError_None;
+    }
+
+    void Cleanup() override
+    {
+        system.reset();
+        compositor.reset();
+    }
+
+    vr::EVRInitError IsInterfaceVersionValid(const char *pchInterfaceVersion) override
+    {
+        if (strcmp(pchInterfaceVersion, vr::IVRSystem_Version) == 0 || strcmp(pchInterfaceVersion, vr::IVRCompositor_Version) == 0)
+            return vr::VRInitError_None;
+        return vr::VRInitError_Init_InterfaceNotFound;
+    }
+
+    void *GetGenericInterface(const char *pchNameAndVersion, vr::EVRInitError *peError) override
+    {
+        void *found = nullptr;
+        if (strcmp(pchNameAndVersion, vr::IVRSystem_Version) == 0)
+            found = system.get();
+        else if (strcmp(pchNameAndVersion, vr::IVRCompositor_Version) == 0)
+            found = compositor.get();
+        if (peError)
+            *peError = found ? vr::VRInitError_None : vr::VRInitError_Init_InterfaceNotFound;
+        return found;
+    }
+
+    bool BIsHmdPresent() override { return true; }
+    const char *GetEnglishStringForHmdError(vr::EVRInitError) override { return "Mock runtime error"; }
+    const char *GetIDForVRInitError(vr::EVRInitError) override { return "VRInitError_Mock"; }
+
+private:
+    std::unique_ptr<MockSystem> system;
+    std::unique_ptr<MockCompositor> compositor;
+};
+
+MockClientCore clientCore;
+
+} // namespace
+
+MOCK_VR_EXPORT void *VRClientCoreFactory(const char *pInterfaceName, int *pReturnCode)
+{
+    if (strcmp(pInterfaceName, vr::IVRClientCore_Version) == 0) {
+        if (pReturnCode)
+            *pReturnCode = vr::VRInitError_None;
+        return &clientCore;
+    }
+    if (pReturnCode)
+        *pReturnCode = vr::VRInitError_Init_InterfaceNotFound;
+    return nullptr;
+}
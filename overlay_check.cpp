@@ -0,0 +1,159 @@
+// Drives StereoOverlay against FakeOverlayBackend, no runtime or GL context needed. Checks which
+// overlay calls each step makes and with what, exits non-zero when any check fails.
+
+#include "stereo_overlay.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <iostream>
+#include <string>
+
+// OverlayBackend that only records what it is asked to do
+class FakeOverlayBackend : public OverlayBackend
+{
+public:
+    // create() fails with this when set
+    vr::EVROverlayError createError = vr::VROverlayError_None;
+
+    int creates = 0, destroys = 0, shows = 0;
+    int textureCalls = 0, boundsCalls = 0, widthCalls = 0, transformCalls = 0;
+    uint64_t flags = 0;
+    vr::Texture_t texture = {};
+    vr::VRTextureBounds_t bounds = {};
+    float widthInMeters = 0.0f;
+    vr::HmdMatrix34_t transform = {};
+
+    vr::EVROverlayError create(const char *key, const char *name, vr::VROverlayHandle_t &handle) override
+    {
+        creates++;
+        handle = createError == vr::VROverlayError_None ? 42 : vr::k_ulOverlayHandleInvalid;
+        return createError;
+    }
+
+    vr::EVROverlayError destroy(vr::VROverlayHandle_t handle) override
+    {
+        destroys++;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError setFlag(vr::VROverlayHandle_t handle, vr::VROverlayFlags flag, bool enabled) override
+    {
+        if (enabled)
+            flags |= flag;
+        else
+            flags &= ~(uint64_t) flag;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError setTexture(vr::VROverlayHandle_t handle, const vr::Texture_t &texture) override
+    {
+        textureCalls++;
+        this->texture = texture;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError setTextureBounds(vr::VROverlayHandle_t handle, const vr::VRTextureBounds_t &bounds) override
+    {
+        boundsCalls++;
+        this->bounds = bounds;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError setWidthInMeters(vr::VROverlayHandle_t handle, float width) override
+    {
+        widthCalls++;
+        widthInMeters = width;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError setTransform(vr::VROverlayHandle_t handle, const vr::HmdMatrix34_t &trackingToOverlay) override
+    {
+        transformCalls++;
+        transform = trackingToOverlay;
+        return vr::VROverlayError_None;
+    }
+
+    vr::EVROverlayError show(vr::VROverlayHandle_t handle) override
+    {
+        shows++;
+        return vr::VROverlayError_None;
+    }
+};
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    std::cout << (ok ? "  ok    " : "  FAIL  ") << what << std::endl;
+    if (!ok)
+        failures++;
+}
+
+// what StereoTextureUpload hands out for a whole side by side pair
+StereoTexture sideBySide(GLuint texture)
+{
+    StereoTexture stereo;
+    stereo.texture[0] = stereo.texture[1] = texture;
+    stereo.uvScaleBias[0] = glm::vec4(0.5f, 1.0f, 0.0f, 0.0f);
+    stereo.uvScaleBias[1] = glm::vec4(0.5f, 1.0f, 0.5f, 0.0f);
+    return stereo;
+}
+
+int main()
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    model[3] = glm::vec4(0.0f, 2.0f, -4.0f, 1.0f);
+
+    std::cout << "Open" << std::endl;
+    FakeOverlayBackend backend;
+    {
+        StereoOverlay overlay(backend);
+        check(overlay.open() && overlay.isOpen(), "open succeeds");
+        check(backend.creates == 1 && backend.shows == 1, "one overlay created and shown");
+        check(backend.flags & vr::VROverlayFlags_SideBySide_Parallel, "side by side flag set");
+        check(backend.boundsCalls == 1 && backend.bounds.vMin == 1.0f && backend.bounds.vMax == 0.0f, "bounds flipped vertically");
+        check(overlay.open() && backend.creates == 1, "open again is a no-op");
+
+        std::cout << "Present" << std::endl;
+        StereoTexture split;
+        split.texture[0] = 1;
+        split.texture[1] = 2;
+        check(!overlay.present(split, model) && backend.textureCalls == 0, "split images are refused");
+        StereoTexture topBottom = sideBySide(3);
+        topBottom.uvScaleBias[0] = glm::vec4(1.0f, 0.5f, 0.0f, 0.0f);
+        check(!overlay.present(topBottom, model) && backend.textureCalls == 0, "top bottom images are refused");
+
+        check(overlay.present(sideBySide(7), model), "side by side image presented");
+        check(backend.textureCalls == 1 && backend.texture.handle == (void *) (uintptr_t) 7 &&
+              backend.texture.eType == vr::TextureType_OpenGL, "texture handed over once");
+        check(backend.widthCalls == 1 && backend.widthInMeters == 2.0f, "width of the unit quad");
+        check(backend.transformCalls == 1 && backend.transform.m[1][3] == 2.0f && backend.transform.m[2][3] == -3.0f,
+              "placed at the quad's face");
+
+        overlay.present(sideBySide(7), model);
+        check(backend.textureCalls == 1 && backend.widthCalls == 1 && backend.transformCalls == 1, "unchanged frame makes no calls");
+
+        glm::mat4 wider = glm::scale(model, glm::vec3(1.5f, 1.0f, 1.0f));
+        overlay.present(sideBySide(7), wider);
+        check(backend.textureCalls == 1 && backend.widthCalls == 2 && backend.widthInMeters == 3.0f, "moved quad only updates placement");
+
+        overlay.present(sideBySide(8), wider);
+        check(backend.textureCalls == 2 && backend.texture.handle == (void *) (uintptr_t) 8 && backend.widthCalls == 2,
+              "new image only updates the texture");
+
+        std::cout << "Close" << std::endl;
+        overlay.close();
+        check(!overlay.isOpen() && backend.destroys == 1, "close destroys the overlay");
+        check(!overlay.present(sideBySide(8), wider), "closed overlay presents nothing");
+    }
+    check(backend.destroys == 1, "destructor after close destroys nothing more");
+
+    std::cout << "Failed create" << std::endl;
+    FakeOverlayBackend failing;
+    failing.createError = vr::VROverlayError_KeyInUse;
+    StereoOverlay overlay(failing);
+    check(!overlay.open() && !overlay.isOpen(), "open fails");
+    check(failing.shows == 0 && !overlay.present(sideBySide(7), model), "nothing shown or presented");
+
+    std::cout << (failures ? "FAILED" : "All checks passed") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+// Pixel repacking kernels used when a decoded image can not be handed to GL as is.
+// Each conversion has an AVX2, an SSE4.1 and a scalar version, the fastest one the
+// CPU supports is picked once at runtime through CPUID.
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics for any instruction set, GCC and Clang need per-function targets
+#if defined(PIXEL_KERNELS_X86) && !defined(_MSC_VER)
+#define PIXEL_KERNELS_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define PIXEL_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_KERNELS_TARGET_SSE41
+#define PIXEL_KERNELS_TARGET_AVX2
+#endif
+
+enum PixelKernelLevel {
+    PIXEL_KERNELS_SCALAR,
+    PIXEL_KERNELS_SSE41,
+    PIXEL_KERNELS_AVX2
+};
+
+// converts one row of width pixels
+typedef void (*PixelRowKernel)(const uint8_t* src, uint8_t* dst, int width);
+
+inline PixelKernelLevel detectPixelKernelLevel()
+{
+#if defined(PIXEL_KERNELS_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    // AVX2 also needs the OS to save the ymm registers
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return PIXEL_KERNELS_AVX2;
+    if (sse41)
+        return PIXEL_KERNELS_SSE41;
+#endif
+    return PIXEL_KERNELS_SCALAR;
+}
+
+inline PixelKernelLevel pixelKernelLevel()
+{
+    static const PixelKernelLevel level = detectPixelKernelLevel();
+    return level;
+}
+
+inline const char* pixelKernelLevelName(PixelKernelLevel level)
+{
+    switch (level) {
+        case PIXEL_KERNELS_AVX2:  return "AVX2";
+        case PIXEL_KERNELS_SSE41: return "SSE4.1";
+        default:                  return "scalar";
+    }
+}
+
+// Scalar kernels, also used for the tails of the SIMD rows
+// ------------------------------------------------------------------------
+inline void bgrToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++, src += 3, dst += 4) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 255;
+    }
+}
+
+inline void bgrToRgbRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++, src += 3, dst += 3) {
+        uint8_t b = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = b;
+    }
+}
+
+// round(v / 257), maps 65535 to 255; width counts channels, not pixels
+inline void depth16To8RowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    for (int x = 0; x < width; x++) {
+        uint32_t t = in[x] + 128u;
+        if (t > 65535u)
+            t = 65535u;
+        dst[x] = (uint8_t) ((t - (t >> 8)) >> 8);
+    }
+}
+
+#if defined(PIXEL_KERNELS_X86)
+// SSE4.1 kernels
+// ------------------------------------------------------------------------
+PIXEL_KERNELS_TARGET_SSE41
+inline void bgrToRgbaRowSSE41(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    int x = 0;
+    // 4 pixels per step, the 16 byte load reads 4 bytes past them
+    for (; x + 6 <= width; x += 4) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3));
+        __m128i out = _mm_or_si128(_mm_shuffle_epi8(in, shuffle), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), out);
+    }
+    bgrToRgbaRowScalar(src + x * 3, dst + x * 4, width - x);
+}
+
+PIXEL_KERNELS_TARGET_SSE41
+inline void bgrToRgbRowSSE41(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+    int x = 0;
+    // 4 pixels per step, the 4 trailing bytes of each store are rewritten by the next one
+    for (; x + 6 <= width; x += 4) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(in, shuffle));
+    }
+    bgrToRgbRowScalar(src + x * 3, dst + x * 3, width - x);
+}
+
+PIXEL_KERNELS_TARGET_SSE41
+inline void depth16To8RowSSE41(const uint8_t* src, uint8_t* dst, int width)
+{
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    const __m128i half = _mm_set1_epi16(128);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x)), half);
+        __m128i b = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 8)), half);
+        a = _mm_srli_epi16(_mm_sub_epi16(a, _mm_srli_epi16(a, 8)), 8);
+        b = _mm_srli_epi16(_mm_sub_epi16(b, _mm_srli_epi16(b, 8)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+    }
+    depth16To8RowScalar(src + x * 2, dst + x, width - x);
+}
+
+// AVX2 kernels, shuffles work per 128 bit lane so each lane gets its own group of pixels
+// ------------------------------------------------------------------------
+PIXEL_KERNELS_TARGET_AVX2
+inline void bgrToRgbaRowAVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                             2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    int x = 0;
+    // 8 pixels per step, the upper lane's load reads 4 bytes past them
+    for (; x + 10 <= width; x += 8) {
+        const uint8_t* s = src + x * 3;
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), 1);
+        __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(in, shuffle), alpha);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), out);
+    }
+    bgrToRgbaRowScalar(src + x * 3, dst + x * 4, width - x);
+}
+
+PIXEL_KERNELS_TARGET_AVX2
+inline void bgrToRgbRowAVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+                                             2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+    int x = 0;
+    for (; x + 10 <= width; x += 8) {
+        const uint8_t* s = src + x * 3;
+        uint8_t* d = dst + x * 3;
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), 1);
+        __m256i out = _mm256_shuffle_epi8(in, shuffle);
+        // lanes hold 12 valid bytes each, store the low one first so the high one overwrites its padding
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(out));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 12), _mm256_extracti128_si256(out, 1));
+    }
+    bgrToRgbRowScalar(src + x * 3, dst + x * 3, width - x);
+}
+
+PIXEL_KERNELS_TARGET_AVX2
+inline void depth16To8RowAVX2(const uint8_t* src, uint8_t* dst, int width)
+{
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    const __m256i half = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i a = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x)), half);
+        __m256i b = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 16)), half);
+        a = _mm256_srli_epi16(_mm256_sub_epi16(a, _mm256_srli_epi16(a, 8)), 8);
+        b = _mm256_srli_epi16(_mm256_sub_epi16(b, _mm256_srli_epi16(b, 8)), 8);
+        // packus interleaves the lanes, permute them back into order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+    }
+    depth16To8RowScalar(src + x * 2, dst + x, width - x);
+}
+#endif
+
+// Dispatch
+// ------------------------------------------------------------------------
+inline PixelRowKernel selectPixelKernel(PixelRowKernel scalar, PixelRowKernel sse41, PixelRowKernel avx2,
+                                        PixelKernelLevel level)
+{
+    if (level == PIXEL_KERNELS_AVX2 && avx2)
+        return avx2;
+    if (level >= PIXEL_KERNELS_SSE41 && sse41)
+        return sse41;
+    return scalar;
+}
+
+#if defined(PIXEL_KERNELS_X86)
+#define PIXEL_KERNEL_VARIANTS(name) name##Scalar, name##SSE41, name##AVX2
+#else
+#define PIXEL_KERNEL_VARIANTS(name) name##Scalar, nullptr, nullptr
+#endif
+
+inline PixelRowKernel bgrToRgbaKernel(PixelKernelLevel level = pixelKernelLevel())
+{
+    return selectPixelKernel(PIXEL_KERNEL_VARIANTS(bgrToRgbaRow), level);
+}
+
+inline PixelRowKernel bgrToRgbKernel(PixelKernelLevel level = pixelKernelLevel())
+{
+    return selectPixelKernel(PIXEL_KERNEL_VARIANTS(bgrToRgbRow), level);
+}
+
+inline PixelRowKernel depth16To8Kernel(PixelKernelLevel level = pixelKernelLevel())
+{
+    return selectPixelKernel(PIXEL_KERNEL_VARIANTS(depth16To8Row), level);
+}
+
+// Runs a row kernel over a whole image, strides are in bytes. The caller owns both buffers,
+// dst is typically upload staging memory (a mapped PBO or a preallocated Mat).
+inline void convertPixels(PixelRowKernel kernel, const uint8_t* src, size_t srcStride,
+                          uint8_t* dst, size_t dstStride, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+        kernel(src + y * srcStride, dst + y * dstStride, width);
+}
+#endif
@@ -0,0 +1,96 @@
+// Microbenchmark for pixel_kernels.h against the equivalent OpenCV conversions.
+// Runs single threaded on 8K, 16K and 32K wide images and checks the results match OpenCV.
+
+#include "opencv2/opencv.hpp"
+#include "pixel_kernels.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+
+const int BENCH_ROWS = 1024;
+const int BENCH_RUNS = 5;
+
+// best of BENCH_RUNS, in milliseconds
+double timeBest(const std::function<void()> &fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+void report(const std::string &name, int width, double ms, bool matches = true)
+{
+    double mpix = (double) width * BENCH_ROWS / 1e6;
+    std::cout << "  " << std::left << std::setw(24) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ms << " ms"
+              << std::setw(10) << std::setprecision(0) << mpix / (ms / 1000.0) << " MPix/s"
+              << (matches ? "" : "  MISMATCH") << std::endl;
+}
+
+bool sameBytes(const cv::Mat &a, const cv::Mat &b)
+{
+    size_t rowBytes = a.cols * a.elemSize();
+    for (int y = 0; y < a.rows; y++)
+        if (memcmp(a.ptr(y), b.ptr(y), rowBytes) != 0)
+            return false;
+    return true;
+}
+
+void benchKernel(const std::string &name, const cv::Mat &src, cv::Mat &dst, const cv::Mat &expected,
+                 PixelRowKernel (*select)(PixelKernelLevel), int rowWidth)
+{
+    PixelKernelLevel levels[] = {PIXEL_KERNELS_SCALAR, PIXEL_KERNELS_SSE41, PIXEL_KERNELS_AVX2};
+    for (PixelKernelLevel level : levels) {
+        if (level > pixelKernelLevel())
+            break;
+        PixelRowKernel kernel = select(level);
+        double ms = timeBest([&] {
+            convertPixels(kernel, src.ptr(), src.step[0], dst.ptr(), dst.step[0], rowWidth, src.rows);
+        });
+        report(name + " " + pixelKernelLevelName(level), src.cols, ms, sameBytes(dst, expected));
+    }
+}
+
+int main()
+{
+    cv::setNumThreads(1);
+    std::cout << "pixel kernels: " << pixelKernelLevelName(pixelKernelLevel()) << ", "
+              << BENCH_ROWS << " rows, best of " << BENCH_RUNS << std::endl;
+
+    for (int width : {8192, 16384, 32768}) {
+        std::cout << width << " px wide" << std::endl;
+
+        cv::Mat bgr(BENCH_ROWS, width, CV_8UC3);
+        cv::Mat bgr16(BENCH_ROWS, width, CV_16UC3);
+        cv::randu(bgr, 0, 256);
+        cv::randu(bgr16, 0, 65536);
+
+        cv::Mat expected, out;
+
+        // BGR -> RGBA
+        report("BGR2RGBA OpenCV", width, timeBest([&] { cv::cvtColor(bgr, expected, cv::COLOR_BGR2RGBA); }));
+        out.create(BENCH_ROWS, width, CV_8UC4);
+        benchKernel("BGR2RGBA", bgr, out, expected, bgrToRgbaKernel, width);
+
+        // BGR -> RGB
+        report("BGR2RGB OpenCV", width, timeBest([&] { cv::cvtColor(bgr, expected, cv::COLOR_BGR2RGB); }));
+        out.create(BENCH_ROWS, width, CV_8UC3);
+        benchKernel("BGR2RGB", bgr, out, expected, bgrToRgbKernel, width);
+
+        // 16-bit -> 8-bit
+        report("16to8 OpenCV", width, timeBest([&] { bgr16.convertTo(expected, CV_8U, 1.0 / 257.0); }));
+        out.create(BENCH_ROWS, width, CV_8UC3);
+        benchKernel("16to8", bgr16, out, expected, depth16To8Kernel, width * 3);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+
+// The images of one directory in name order, with a cursor that wraps around at both ends
+class Playlist
+{
+public:
+    // path may be a directory, or an image whose directory is opened with the cursor on it.
+    // Fails, leaving the playlist as it was, when path does not exist.
+    bool open(const std::string &path)
+    {
+        namespace fs = std::filesystem;
+        std::error_code error;
+        fs::path target(path);
+        if (!fs::exists(target, error))
+            return false;
+        fs::path directory = fs::is_directory(target, error) ? target : target.parent_path();
+        if (directory.empty())
+            directory = ".";
+
+        std::vector<std::string> found;
+        for (const fs::directory_entry &entry : fs::directory_iterator(directory, error))
+        {
+            if (entry.is_regular_file(error) && isImage(entry.path()))
+                found.push_back(entry.path().string());
+        }
+        if (error || found.empty())
+            return false;
+
+        std::sort(found.begin(), found.end());
+        files = found;
+        cursor = 0;
+
+        if (!fs::is_directory(target, error))
+        {
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                if (fs::equivalent(files[i], target, error))
+                    cursor = i;
+            }
+        }
+        return true;
+    }
+
+    bool empty() const { return files.empty(); }
+    size_t size() const { return files.size(); }
+    size_t index() const { return cursor; }
+
+    const std::string &current() const
+    {
+        static const std::string none;
+        return files.empty() ? none : files[cursor];
+    }
+
+    void next()
+    {
+        if (!files.empty())
+            cursor = (cursor + 1) % files.size();
+    }
+
+    void previous()
+    {
+        if (!files.empty())
+            cursor = (cursor + files.size() - 1) % files.size();
+    }
+
+    // the images up to radius steps away from the cursor, nearest first, alternating ahead and behind
+    std::vector<std::string> neighbours(int radius) const
+    {
+        std::vector<std::string> result;
+        if (files.empty())
+            return result;
+        radius = std::min(radius, (int) (files.size() - 1) / 2 + 1);
+        for (int step = 1; step <= radius; step++)
+        {
+            for (int direction : {1, -1})
+            {
+                const std::string &file = files[(cursor + files.size() + direction * step) % files.size()];
+                if (file != files[cursor] && std::find(result.begin(), result.end(), file) == result.end())
+                    result.push_back(file);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::string> files;
+    size_t cursor = 0;
+
+    static bool isImage(const std::filesystem::path &path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return (char) std::tolower(c); });
+        for (const char *supported : {".jpg", ".jpeg", ".png", ".tif", ".tiff", ".bmp", ".webp"})
+        {
+            if (extension == supported)
+                return true;
+        }
+        return false;
+    }
+};
+#endif
@@ -0,0 +1,147 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include "fnv1a.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+
+// On-disk cache of linked programs from glGetProgramBinary. Entries are keyed on the shader
+// sources and on the driver (vendor, renderer, version), so a driver update simply misses.
+// A binary the driver rejects anyway is dropped and the caller compiles from source.
+//
+// File layout: ProgramCacheHeader, then the binary.
+class ProgramBinaryCache
+{
+public:
+    explicit ProgramBinaryCache(const std::string &directory) : directory(directory) {}
+
+    // Needs GL_ARB_get_program_binary (core in 4.1) and a driver exposing at least one format
+    bool supported() const
+    {
+        if (!GLAD_GL_VERSION_4_1)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    std::string key(const std::vector<std::string> &sources) const
+    {
+        uint64_t hash = fnv1a64(driver());
+        for (const std::string &source : sources)
+            hash = fnv1a64(source + '\0', hash);
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return name.str();
+    }
+
+    // Loads the cached binary of key into program, true when it linked
+    bool load(GLuint program, const std::string &key)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(path(key), std::ios::binary);
+        if (!in)
+            return false;
+        ProgramCacheHeader header;
+        if (!in.read((char*) &header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0)
+            return false;
+        if (header.length == 0 || header.length > MAX_BINARY_BYTES)
+            return false;
+        std::vector<char> binary(header.length);
+        if (!in.read(binary.data(), binary.size()))
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            std::error_code error;
+            std::filesystem::remove(path(key), error);
+            rejected++;
+            return false;
+        }
+        loaded++;
+        savedMs += header.buildMs;
+        loadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // Stores a linked program, built from source in buildMs, under key
+    void store(GLuint program, const std::string &key, double buildMs)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        ProgramCacheHeader header = {};
+        memcpy(header.magic, MAGIC, sizeof(header.magic));
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+        header.format = format;
+        header.length = (uint32_t) length;
+        header.buildMs = (float) buildMs;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::ofstream out(path(key), std::ios::binary | std::ios::trunc);
+        out.write((const char*) &header, sizeof(header));
+        out.write(binary.data(), binary.size());
+        stored++;
+    }
+
+    // what the cache saved this run, against compiling every program from source
+    void report() const
+    {
+        std::cout << "Program cache: " << loaded << " loaded in " << loadMs << " ms, saving ~" << (savedMs - loadMs)
+                  << " ms; " << stored << " compiled and stored, " << rejected << " rejected" << std::endl;
+    }
+
+private:
+    struct ProgramCacheHeader
+    {
+        char magic[8];
+        uint32_t format;
+        uint32_t length;
+        float buildMs;
+        uint32_t reserved;
+    };
+
+    static constexpr char MAGIC[8] = {'G', 'L', 'V', 'R', 'P', 'R', 'G', '\0'};
+    static const uint32_t MAX_BINARY_BYTES = 64u << 20;
+
+    std::string directory;
+    int loaded = 0;
+    int stored = 0;
+    int rejected = 0;
+    double savedMs = 0.0;
+    double loadMs = 0.0;
+
+    std::string path(const std::string &key) const
+    {
+        return (std::filesystem::path(directory) / (key + ".glprog")).string();
+    }
+
+    static std::string driver()
+    {
+        std::string text;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const char *value = (const char*) glGetString(name);
+            text += value ? value : "";
+            text += '\n';
+        }
+        return text;
+    }
+};
+#endif
@@ -0,0 +1,113 @@
+#ifndef QUAD_SCISSOR_H
+#define QUAD_SCISSOR_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Pixel rectangle in an eye buffer, origin bottom left like glScissor
+struct PixelRect
+{
+    int x = 0, y = 0;
+    int width = 0, height = 0;
+
+    bool empty() const { return width <= 0 || height <= 0; }
+
+    PixelRect united(const PixelRect &other) const
+    {
+        if (empty())
+            return other;
+        if (other.empty())
+            return *this;
+        PixelRect rect;
+        rect.x = std::min(x, other.x);
+        rect.y = std::min(y, other.y);
+        rect.width = std::max(x + width, other.x + other.width) - rect.x;
+        rect.height = std::max(y + height, other.y + other.height) - rect.y;
+        return rect;
+    }
+};
+
+// Conservative pixel bounds of the quad (the [-1, 1] square at z = 1 in model space) inside
+// a width x height viewport. The whole viewport when a corner lies behind the eye.
+inline PixelRect projectQuadRect(const glm::mat4 &mvp, int width, int height)
+{
+    PixelRect full;
+    full.width = width;
+    full.height = height;
+
+    glm::vec2 low(1.0f), high(-1.0f);
+    for (float x : {-1.0f, 1.0f}) {
+        for (float y : {-1.0f, 1.0f}) {
+            glm::vec4 clip = mvp * glm::vec4(x, y, 1.0f, 1.0f);
+            if (clip.w <= 0.0f)
+                return full;
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            low = glm::min(low, ndc);
+            high = glm::max(high, ndc);
+        }
+    }
+
+    // one pixel of slack around the edges covers rasterisation rounding
+    int x0 = std::max(0, (int) std::floor((low.x * 0.5f + 0.5f) * width) - 1);
+    int y0 = std::max(0, (int) std::floor((low.y * 0.5f + 0.5f) * height) - 1);
+    int x1 = std::min(width, (int) std::ceil((high.x * 0.5f + 0.5f) * width) + 1);
+    int y1 = std::min(height, (int) std::ceil((high.y * 0.5f + 0.5f) * height) + 1);
+
+    PixelRect rect;
+    rect.x = x0;
+    rect.y = y0;
+    rect.width = std::max(0, x1 - x0);
+    rect.height = std::max(0, y1 - y0);
+    return rect;
+}
+
+// Tracks what part of each eye buffer has to be cleared and drawn. Outside the quad the buffers
+// hold nothing but the clear color, so a frame only needs to touch where the quad is now plus
+// where it was last frame. Anything that may have dirtied the rest calls invalidate() for a
+// full clear.
+class QuadScissor
+{
+public:
+    // rect to clear and draw this frame, for target slot (an eye, or 0 for a layered target)
+    PixelRect update(int slot, const PixelRect &quad, int viewportWidth, int viewportHeight)
+    {
+        Slot &state = slots[slot];
+        PixelRect rect;
+        if (!state.valid || state.viewportWidth != viewportWidth || state.viewportHeight != viewportHeight) {
+            rect.width = viewportWidth;
+            rect.height = viewportHeight;
+        } else {
+            rect = quad.united(state.previous);
+        }
+        state.previous = quad;
+        state.viewportWidth = viewportWidth;
+        state.viewportHeight = viewportHeight;
+        state.valid = true;
+        return rect;
+    }
+
+    void invalidate()
+    {
+        for (Slot &state : slots)
+            state.valid = false;
+    }
+
+private:
+    struct Slot
+    {
+        PixelRect previous;
+        int viewportWidth = 0;
+        int viewportHeight = 0;
+        bool valid = false;
+    };
+    Slot slots[2];
+};
+
+inline void setScissor(const PixelRect &rect)
+{
+    glScissor(rect.x, rect.y, rect.width, rect.height);
+}
+#endif
@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in int Eye;
+flat in vec4 EyeRect;
+
+// quad texture of each eye, the same texture twice unless the image was split
+uniform sampler2D eyeTexture0;
+uniform sampler2D eyeTexture1;
+
+// see camera.fs
+vec2 clampToEye(sampler2D tex, vec2 uv, vec4 rect)
+{
+	vec2 inset = max(0.5 / vec2(textureSize(tex, 0)), fwidth(uv));
+	return clamp(uv, rect.xy + inset, rect.zw - inset);
+}
+
+void main()
+{
+	// samplers can not be indexed dynamically in 3.30; Eye is constant per triangle
+	vec2 dx = dFdx(TexCoord);
+	vec2 dy = dFdy(TexCoord);
+	if (Eye == 0)
+		FragColor = textureGrad(eyeTexture0, clampToEye(eyeTexture0, TexCoord, EyeRect), dx, dy);
+	else
+		FragColor = textureGrad(eyeTexture1, clampToEye(eyeTexture1, TexCoord, EyeRect), dx, dy);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+// Routes every triangle to the array layer of the eye it was instanced for
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec2 vTexCoord[];
+flat in int vEye[];
+flat in vec4 vEyeRect[];
+
+out vec2 TexCoord;
+flat out int Eye;
+flat out vec4 EyeRect;
+
+void main()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Layer = vEye[i];
+		Eye = vEye[i];
+		EyeRect = vEyeRect[i];
+		TexCoord = vTexCoord[i];
+		gl_Position = gl_in[i].gl_Position;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
\ No newline at end of file
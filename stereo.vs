@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 vTexCoord;
+flat out int vEye;
+flat out vec4 vEyeRect;
+
+// both eyes of the frame, indexed by instance: 0 = left, 1 = right
+layout (std140) uniform StereoFrame
+{
+	mat4 mvp[2];
+	vec4 uvScaleBias[2];
+};
+
+
+void main()
+{
+	vEye = gl_InstanceID;
+	vTexCoord = aTexCoord * uvScaleBias[vEye].xy + uvScaleBias[vEye].zw;
+	vEyeRect = vec4(uvScaleBias[vEye].zw, uvScaleBias[vEye].zw + uvScaleBias[vEye].xy);
+	gl_Position = mvp[vEye] * vec4(aPos, 1.0f);
+}
\ No newline at end of file
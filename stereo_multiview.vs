@@ -0,0 +1,25 @@
+#version 330 core
+#extension GL_OVR_multiview2 : require
+// the driver runs this once per view, gl_ViewID_OVR picks the eye and the array layer
+layout (num_views = 2) in;
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+flat out int Eye;
+flat out vec4 EyeRect;
+
+layout (std140) uniform StereoFrame
+{
+	mat4 mvp[2];
+	vec4 uvScaleBias[2];
+};
+
+
+void main()
+{
+	Eye = int(gl_ViewID_OVR);
+	TexCoord = aTexCoord * uvScaleBias[Eye].xy + uvScaleBias[Eye].zw;
+	EyeRect = vec4(uvScaleBias[Eye].zw, uvScaleBias[Eye].zw + uvScaleBias[Eye].xy);
+	gl_Position = mvp[Eye] * vec4(aPos, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#ifndef STEREO_OVERLAY_H
+#define STEREO_OVERLAY_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "openvr.h"
+
+#include "stereo_texture_handle.h"
+
+#include <iostream>
+
+// The few IVROverlay calls the stereo overlay needs. Lets the overlay run against a fake
+// compositor, since vr::IVROverlay itself is far too large to stand in for.
+class OverlayBackend
+{
+public:
+    virtual ~OverlayBackend() {}
+    virtual vr::EVROverlayError create(const char *key, const char *name, vr::VROverlayHandle_t &handle) = 0;
+    virtual vr::EVROverlayError destroy(vr::VROverlayHandle_t handle) = 0;
+    virtual vr::EVROverlayError setFlag(vr::VROverlayHandle_t handle, vr::VROverlayFlags flag, bool enabled) = 0;
+    virtual vr::EVROverlayError setTexture(vr::VROverlayHandle_t handle, const vr::Texture_t &texture) = 0;
+    virtual vr::EVROverlayError setTextureBounds(vr::VROverlayHandle_t handle, const vr::VRTextureBounds_t &bounds) = 0;
+    virtual vr::EVROverlayError setWidthInMeters(vr::VROverlayHandle_t handle, float width) = 0;
+    virtual vr::EVROverlayError setTransform(vr::VROverlayHandle_t handle, const vr::HmdMatrix34_t &trackingToOverlay) = 0;
+    virtual vr::EVROverlayError show(vr::VROverlayHandle_t handle) = 0;
+};
+
+// OverlayBackend of the running OpenVR runtime
+class OpenVROverlayBackend : public OverlayBackend
+{
+public:
+    vr::EVROverlayError create(const char *key, const char *name, vr::VROverlayHandle_t &handle) override
+    {
+        return vr::VROverlay()->CreateOverlay(key, name, &handle);
+    }
+
+    vr::EVROverlayError destroy(vr::VROverlayHandle_t handle) override
+    {
+        return vr::VROverlay()->DestroyOverlay(handle);
+    }
+
+    vr::EVROverlayError setFlag(vr::VROverlayHandle_t handle, vr::VROverlayFlags flag, bool enabled) override
+    {
+        return vr::VROverlay()->SetOverlayFlag(handle, flag, enabled);
+    }
+
+    vr::EVROverlayError setTexture(vr::VROverlayHandle_t handle, const vr::Texture_t &texture) override
+    {
+        return vr::VROverlay()->SetOverlayTexture(handle, &texture);
+    }
+
+    vr::EVROverlayError setTextureBounds(vr::VROverlayHandle_t handle, const vr::VRTextureBounds_t &bounds) override
+    {
+        return vr::VROverlay()->SetOverlayTextureBounds(handle, &bounds);
+    }
+
+    vr::EVROverlayError setWidthInMeters(vr::VROverlayHandle_t handle, float width) override
+    {
+        return vr::VROverlay()->SetOverlayWidthInMeters(handle, width);
+    }
+
+    vr::EVROverlayError setTransform(vr::VROverlayHandle_t handle, const vr::HmdMatrix34_t &trackingToOverlay) override
+    {
+        return vr::VROverlay()->SetOverlayTransformAbsolute(handle, vr::VRCompositor()->GetTrackingSpace(), &trackingToOverlay);
+    }
+
+    vr::EVROverlayError show(vr::VROverlayHandle_t handle) override
+    {
+        return vr::VROverlay()->ShowOverlay(handle);
+    }
+};
+
+// Hands the uploaded side by side texture to the compositor as a stereo overlay, which then
+// draws the photo itself: no eye buffers, no depth, no per eye draw on our side.
+// Only whole side by side textures qualify; split or top bottom images need scene rendering.
+class StereoOverlay
+{
+public:
+    explicit StereoOverlay(OverlayBackend &backend) : backend(backend) {}
+    StereoOverlay(const StereoOverlay&) = delete;
+    StereoOverlay& operator=(const StereoOverlay&) = delete;
+
+    ~StereoOverlay()
+    {
+        close();
+    }
+
+    bool open()
+    {
+        if (handle != vr::k_ulOverlayHandleInvalid)
+            return true;
+        vr::EVROverlayError error = backend.create("glvr.stereo", "GLVR", handle);
+        if (error != vr::VROverlayError_None) {
+            std::cout << "Overlay creation failed: " << error << std::endl;
+            handle = vr::k_ulOverlayHandleInvalid;
+            return false;
+        }
+        backend.setFlag(handle, vr::VROverlayFlags_SideBySide_Parallel, true);
+        // quad textures are uploaded top row first, GL overlays are read bottom up
+        vr::VRTextureBounds_t flipped = {0.0f, 1.0f, 1.0f, 0.0f};
+        backend.setTextureBounds(handle, flipped);
+        backend.show(handle);
+        return true;
+    }
+
+    void close()
+    {
+        if (handle != vr::k_ulOverlayHandleInvalid)
+            backend.destroy(handle);
+        handle = vr::k_ulOverlayHandleInvalid;
+        texture = 0;
+    }
+
+    bool isOpen() const
+    {
+        return handle != vr::k_ulOverlayHandleInvalid;
+    }
+
+    static bool supports(const StereoTexture &stereo)
+    {
+        return stereo.valid() && stereo.texture[0] == stereo.texture[1] &&
+               stereo.uvScaleBias[0] == glm::vec4(0.5f, 1.0f, 0.0f, 0.0f);
+    }
+
+    // Places the overlay where the quad of model (the [-1, 1] square at z = 1) would be and
+    // shows stereo on it. Calls reach the backend only for what changed since the last one.
+    bool present(const StereoTexture &stereo, const glm::mat4 &model)
+    {
+        if (!isOpen() || !supports(stereo))
+            return false;
+
+        if (stereo.texture[0] != texture) {
+            vr::Texture_t overlayTexture = {(void *) (uintptr_t) stereo.texture[0], vr::TextureType_OpenGL, vr::ColorSpace_Gamma};
+            if (backend.setTexture(handle, overlayTexture) != vr::VROverlayError_None)
+                return false;
+            texture = stereo.texture[0];
+        }
+
+        if (model != placement) {
+            glm::vec4 center = model * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            float width = glm::length(glm::vec3(model[0])) * 2.0f;
+            // the overlay takes its height from the texture aspect, only the position and width matter
+            vr::HmdMatrix34_t transform = {{
+                {1.0f, 0.0f, 0.0f, center.x},
+                {0.0f, 1.0f, 0.0f, center.y},
+                {0.0f, 0.0f, 1.0f, center.z}
+            }};
+            backend.setWidthInMeters(handle, width);
+            backend.setTransform(handle, transform);
+            placement = model;
+        }
+        return true;
+    }
+
+private:
+    OverlayBackend &backend;
+    vr::VROverlayHandle_t handle = vr::k_ulOverlayHandleInvalid;
+    GLuint texture = 0;
+    glm::mat4 placement = glm::mat4(0.0f);
+};
+#endif
@@ -0,0 +1,217 @@
+#ifndef STEREO_TEXTURE_H
+#define STEREO_TEXTURE_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "opencv2/opencv.hpp"
+
+#include "image_loader.h"
+#include "stereo_texture_handle.h"
+#include "mip_builder.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <vector>
+
+// Lets GL read a Mat in place, including a ROI whose rows are strided by the parent Mat's step
+inline void setUnpackStateForMat(const cv::Mat& mat){
+    size_t step = mat.step[0];
+    GLint alignment = 8;
+    while (step % alignment)
+        alignment >>= 1;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint) (step / mat.elemSize()));
+}
+
+inline void resetUnpackState(){
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+// RGBA8 size of a texture with a full mip chain
+inline size_t textureBytes(const cv::Mat& image){
+    return (size_t) image.cols * image.rows * 4 * 4 / 3;
+}
+
+// Storage for image and mipCount levels below it, filled in later by StereoTextureUpload.
+// Without CPU built levels glGenerateMipmap allocates the rest of the chain.
+inline GLuint allocateQuadTexture(const cv::Mat& image, size_t mipCount){
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // the far edge of an eye is the far edge of its image, never the opposite side
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    int width = image.cols, height = image.rows;
+    for (size_t level = 0; level <= mipCount; level++) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint) level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    if (mipCount > 0)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) mipCount);
+    return texture;
+}
+
+inline void deleteStereoTexture(StereoTexture& stereo){
+    glDeleteTextures(1, &stereo.texture[0]);
+    if (stereo.texture[1] != stereo.texture[0])
+        glDeleteTextures(1, &stereo.texture[1]);
+    stereo = StereoTexture();
+}
+
+// Uploads a decoded image into a new StereoTexture over as many frames as it takes. Each step()
+// copies rows with glTexSubImage2D until its byte budget is spent, so even a 50+ MP image costs
+// the render thread a bounded slice per frame instead of one long stall between Submit and the
+// next WaitGetPoses. The texture is only handed out by take() once every level is in; until then
+// whatever is on screen stays there.
+//
+// Pixels go up straight from the decoded buffers, the channel swizzle is left to the driver so
+// no intermediate copy is made. rgbOrder is for images the loader already repacked on the CPU.
+class StereoTextureUpload
+{
+public:
+    typedef DecodedImage::Clock Clock;
+
+    // when begin() was called and how many step() calls it has taken since
+    Clock::time_point started;
+    int frames = 0;
+
+    // starts uploading decoded, dropping whatever was still in progress
+    void begin(const DecodedImage& decoded)
+    {
+        cancel();
+        image = decoded;
+        started = Clock::now();
+        frames = 0;
+        if (image.rgbOrder)
+            format = (image.isSplit() ? image.left : image.image).channels() == 4 ? GL_RGBA : GL_RGB;
+        else
+            format = (image.isSplit() ? image.left : image.image).channels() == 4 ? GL_BGRA : GL_BGR;
+
+        stereo.decodeScale = image.decodeScale;
+        stereo.sourceEyeWidth = image.sourceEyeWidth;
+        if (image.isSplit()) {
+            stereo.texture[0] = addTexture(image.left, image.leftMips);
+            stereo.texture[1] = addTexture(image.right, image.rightMips);
+            stereo.aspect = (float) image.left.rows / image.left.cols;
+            stereo.bytes = textureBytes(image.left) + textureBytes(image.right);
+            return;
+        }
+
+        // Whole pair uploaded once, each eye samples its own half
+        GLuint texture = addTexture(image.image, image.imageMips);
+        stereo.texture[0] = texture;
+        stereo.texture[1] = texture;
+        stereo.bytes = textureBytes(image.image);
+        if (image.layout == SIDE_BY_SIDE) {
+            stereo.uvScaleBias[0] = glm::vec4(0.5f, 1.0f, 0.0f, 0.0f);
+            stereo.uvScaleBias[1] = glm::vec4(0.5f, 1.0f, 0.5f, 0.0f);
+            stereo.aspect = (float) image.image.rows / (image.image.cols / 2);
+        } else {
+            stereo.uvScaleBias[0] = glm::vec4(1.0f, 0.5f, 0.0f, 0.0f);
+            stereo.uvScaleBias[1] = glm::vec4(1.0f, 0.5f, 0.0f, 0.5f);
+            stereo.aspect = (float) (image.image.rows / 2) / image.image.cols;
+        }
+    }
+
+    bool active() const
+    {
+        return stereo.valid();
+    }
+
+    // what is being uploaded, valid while active()
+    const DecodedImage& source() const
+    {
+        return image;
+    }
+
+    // Uploads at least one row and otherwise up to budgetBytes, true once everything is in
+    bool step(size_t budgetBytes)
+    {
+        TRACE_ZONE("Upload step");
+        frames++;
+        size_t spent = 0;
+        while (next < levels.size() && spent < budgetBytes) {
+            const Level& level = levels[next];
+            size_t rowBytes = level.pixels.cols * level.pixels.elemSize();
+            int rows = (int) std::min<size_t>(level.pixels.rows - row, std::max<size_t>(1, (budgetBytes - spent) / rowBytes));
+
+            glBindTexture(GL_TEXTURE_2D, level.texture);
+            setUnpackStateForMat(level.pixels);
+            glTexSubImage2D(GL_TEXTURE_2D, level.level, 0, row, level.pixels.cols, rows, format, GL_UNSIGNED_BYTE, level.pixels.ptr(row));
+            spent += rows * rowBytes;
+            row += rows;
+            if (row == level.pixels.rows) {
+                row = 0;
+                next++;
+            }
+        }
+        resetUnpackState();
+        if (next < levels.size())
+            return false;
+
+        // fallback for images that came without a CPU built chain
+        for (GLuint texture : generateMips) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        return true;
+    }
+
+    // the finished texture, ownership passes to the caller
+    StereoTexture take()
+    {
+        StereoTexture result = stereo;
+        stereo = StereoTexture();
+        reset();
+        return result;
+    }
+
+    void cancel()
+    {
+        if (stereo.valid())
+            deleteStereoTexture(stereo);
+        reset();
+    }
+
+private:
+    struct Level
+    {
+        GLuint texture;
+        GLint level;
+        cv::Mat pixels;
+    };
+
+    DecodedImage image;
+    StereoTexture stereo;
+    GLenum format = GL_BGR;
+    std::vector<Level> levels;
+    std::vector<GLuint> generateMips;
+    size_t next = 0;
+    int row = 0;
+
+    GLuint addTexture(const cv::Mat& base, const MipChain& mips)
+    {
+        GLuint texture = allocateQuadTexture(base, mips.size());
+        levels.push_back({texture, 0, base});
+        for (size_t i = 0; i < mips.size(); i++)
+            levels.push_back({texture, (GLint) i + 1, mips[i]});
+        if (mips.empty())
+            generateMips.push_back(texture);
+        return texture;
+    }
+
+    void reset()
+    {
+        image = DecodedImage();
+        levels.clear();
+        generateMips.clear();
+        next = 0;
+        row = 0;
+    }
+};
+#endif
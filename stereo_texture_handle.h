@@ -0,0 +1,25 @@
+#ifndef STEREO_TEXTURE_HANDLE_H
+#define STEREO_TEXTURE_HANDLE_H
+
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+
+#include <cstddef>
+
+// GPU side of a stereo image. In single texture mode both eyes share the same texture and
+// select their half through uvScaleBias (xy = scale, zw = bias), applied in camera.vs. The
+// fragment shaders keep each eye's samples inside its half, see clampToEye in camera.fs.
+struct StereoTexture
+{
+    GLuint texture[2] = {0, 0};
+    glm::vec4 uvScaleBias[2] = {glm::vec4(1.0f, 1.0f, 0.0f, 0.0f), glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)};
+    float aspect = 1.0f;
+    // approximate VRAM held, for the texture cache budget
+    size_t bytes = 0;
+    // see DecodedImage, tells whether zooming in needs a finer decode
+    int decodeScale = 1;
+    int sourceEyeWidth = 0;
+
+    bool valid() const { return texture[0] && texture[1]; }
+};
+#endif
@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <string>
+
+#include "trace.h"
+
+// Fixed set of worker threads running queued tasks in FIFO order
+class ThreadPool
+{
+public:
+    // workers show up in traces as "name index"
+    explicit ThreadPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency()),
+                        const std::string &name = "Worker")
+    {
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::run, this, name + " " + std::to_string(i));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            tasks.clear();
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // drops every task that has not started yet
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.clear();
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void run(std::string name)
+    {
+        trace::setThreadName(name);
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quit || !tasks.empty(); });
+                if (quit)
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+#endif
@@ -0,0 +1,191 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU zone tracing for any thread, written out as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+//     void decode() { TRACE_ZONE("Decode"); ... }
+//
+// Each thread appends finished zones to its own buffer, so recording takes no lock and no
+// allocation. A buffer has two halves: capture() flips every thread over to the other half and
+// then reads the one just closed, while the threads keep recording. Zones a thread records
+// past a half's capacity are dropped and counted. write() exports a capture as JSON, callers on
+// a frame loop take the capture there and hand the export to another thread.
+namespace trace {
+
+struct Event
+{
+    const char *name;
+    int64_t startNs;
+    int64_t durationNs;
+};
+
+struct ThreadEvents
+{
+    static const uint32_t CAPACITY = 1u << 14;
+
+    uint32_t id = 0;
+    std::string name;
+    std::vector<Event> events[2];
+    std::atomic<uint32_t> count[2] = {{0}, {0}};
+    // the capture each half last belonged to
+    std::atomic<uint32_t> capture[2] = {{~0u}, {~0u}};
+    std::atomic<uint32_t> dropped = {0};
+};
+
+inline std::atomic<bool> enabled = {true};
+inline std::atomic<uint32_t> currentCapture = {0};
+inline std::mutex registryMutex;
+inline std::vector<std::unique_ptr<ThreadEvents>> registry;
+inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+inline int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// this thread's buffer, registered on first use
+inline ThreadEvents &threadEvents()
+{
+    thread_local ThreadEvents *events = nullptr;
+    if (!events) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ThreadEvents());
+        events = registry.back().get();
+        events->id = (uint32_t) registry.size();
+        events->name = "Thread " + std::to_string(events->id);
+        events->events[0].resize(ThreadEvents::CAPACITY);
+        events->events[1].resize(ThreadEvents::CAPACITY);
+    }
+    return *events;
+}
+
+inline void setThreadName(const std::string &name)
+{
+    ThreadEvents &thread = threadEvents();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    thread.name = name;
+}
+
+inline void record(const char *name, int64_t startNs, int64_t endNs)
+{
+    ThreadEvents &thread = threadEvents();
+    uint32_t capture = currentCapture.load(std::memory_order_acquire);
+    int half = capture & 1;
+    if (thread.capture[half].load(std::memory_order_relaxed) != capture) {
+        thread.count[half].store(0, std::memory_order_relaxed);
+        thread.capture[half].store(capture, std::memory_order_release);
+    }
+    uint32_t count = thread.count[half].load(std::memory_order_relaxed);
+    if (count >= ThreadEvents::CAPACITY) {
+        thread.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    thread.events[half][count] = {name, startNs, endNs - startNs};
+    thread.count[half].store(count + 1, std::memory_order_release);
+}
+
+// Times its own scope. name must outlive the export of its capture, in practice a string literal.
+class Zone
+{
+public:
+    explicit Zone(const char *name) : name(name), startNs(enabled.load(std::memory_order_relaxed) ? nowNs() : -1) {}
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+    ~Zone()
+    {
+        if (startNs >= 0)
+            record(name, startNs, nowNs());
+    }
+
+private:
+    const char *name;
+    int64_t startNs;
+};
+
+// Zones of one capture, copied out of the thread buffers
+struct Capture
+{
+    struct Thread
+    {
+        uint32_t id;
+        std::string name;
+        std::vector<Event> events;
+        uint32_t dropped;
+    };
+    std::vector<Thread> threads;
+    int64_t endNs = 0;
+};
+
+// Takes everything recorded since the previous capture and starts a new one
+inline Capture capture()
+{
+    uint32_t capture = currentCapture.fetch_add(1, std::memory_order_acq_rel);
+    int half = capture & 1;
+
+    Capture result;
+    result.endNs = nowNs();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    result.threads.reserve(registry.size());
+    for (const std::unique_ptr<ThreadEvents> &thread : registry) {
+        Capture::Thread copy = {thread->id, thread->name, {}, thread->dropped.exchange(0, std::memory_order_relaxed)};
+        if (thread->capture[half].load(std::memory_order_acquire) == capture) {
+            uint32_t count = thread->count[half].load(std::memory_order_acquire);
+            copy.events.assign(thread->events[half].begin(), thread->events[half].begin() + count);
+        }
+        result.threads.push_back(std::move(copy));
+    }
+    return result;
+}
+
+// Writes capture to path as Chrome trace JSON, from any thread.
+// Returns the number of zones written, -1 when path can not be written.
+inline int write(const std::string &path, const Capture &capture)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        return -1;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    int written = 0;
+    bool first = true;
+    for (const Capture::Thread &thread : capture.threads) {
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id
+            << ",\"args\":{\"name\":\"" << thread.name << "\"}}";
+        first = false;
+        for (const Event &event : thread.events) {
+            // microseconds, with the nanoseconds kept as decimals
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.id
+                << ",\"ts\":" << event.startNs / 1000 << "." << event.startNs % 1000 / 100
+                << ",\"dur\":" << event.durationNs / 1000 << "." << event.durationNs % 1000 / 100 << "}";
+        }
+        written += (int) thread.events.size();
+        if (thread.dropped)
+            out << ",\n{\"name\":\"" << thread.dropped << " zones dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+                << thread.id << ",\"ts\":" << capture.endNs / 1000 << "}";
+    }
+    out << "\n]}\n";
+    return out ? written : -1;
+}
+
+// Writes everything recorded since the previous capture to path, on the calling thread
+inline int write(const std::string &path)
+{
+    return write(path, capture());
+}
+
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// times the rest of the enclosing scope as name
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#endif
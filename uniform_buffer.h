@@ -0,0 +1,52 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+// A uniform buffer holding one Block, bound to a fixed binding point that shaders attach their
+// uniform block to with Shader::bindUniformBlock. Block must follow the std140 layout.
+template <typename Block>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding) {}
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    ~UniformBuffer()
+    {
+        destroy();
+    }
+
+    void create()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    void destroy()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+    // One upload for everything drawn until the next update. Respecifying the whole store
+    // lets the driver hand out fresh memory instead of waiting on draws still reading the old.
+    void update(const Block &block)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+    }
+
+    GLuint bindingPoint() const
+    {
+        return binding;
+    }
+
+private:
+    GLuint binding;
+    GLuint buffer = 0;
+};
+#endif